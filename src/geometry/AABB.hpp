@@ -63,6 +63,17 @@ public:
   [[nodiscard]] auto z() const -> interval {
     return axis[2];
   }
+  // 表面积，SAH 代价估计使用
+  [[nodiscard]] auto surface_area() const -> double {
+    auto dx = axis[0].size(), dy = axis[1].size(), dz = axis[2].size();
+    return 2.0 * (dx * dy + dy * dz + dz * dx);
+  }
+  // 最长的轴 x : 0, y : 1, z : 2
+  [[nodiscard]] auto longest_axis() const -> int {
+    if (axis[0].size() > axis[1].size())
+      return axis[0].size() > axis[2].size() ? 0 : 2;
+    return axis[1].size() > axis[2].size() ? 1 : 2;
+  }
   auto pad() -> aabb {
     // Return an AABB that has no side narrower than some delta, padding if necessary.
     double delta = 0.0001;
@@ -2,6 +2,7 @@
 #define BVH_HPP
 
 #include "../global.hpp"
+#include "bvh_build.hpp"
 #include "hittablelist.hpp"
 #include "interval.hpp"
 
@@ -17,21 +18,38 @@ inline auto box_z_compare(
 /*
   BVH 的结点（也是可背光线击中的）
   左右儿子 + 自己的 AABB
+  SAH 建树时叶子结点的 left/right 为空，物体存放在 prims 中
 */
 class bvh_node : public hittable {
 public:
   std::unique_ptr<hittable> left;
   std::unique_ptr<hittable> right;
+  std::vector<std::unique_ptr<hittable>> prims; // 叶子中的物体
   aabb bbox;
+  int axis = 0; // 划分轴
 
 public:
   bvh_node();
 
-  bvh_node(hittable_list &list) : bvh_node(list.objects, 0, list.objects.size()) {}
+  bvh_node(hittable_list &list, bvh_split split = bvh_split::SAH)
+      : bvh_node(list.objects, 0, list.objects.size(), split) {}
 
-  bvh_node(std::vector<std::unique_ptr<hittable>> &src_objects, size_t start, size_t end);
+  /**
+   * @param depth 当前深度，靠近根的大子树会另开线程并行建树
+   */
+  bvh_node(std::vector<std::unique_ptr<hittable>> &src_objects, size_t start, size_t end,
+      bvh_split split = bvh_split::SAH, int depth = 0);
 
-  auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  [[nodiscard]] auto is_leaf() const -> bool {
+    return !prims.empty();
+  }
+
+  auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override {
+    return hit_deferred(*this, r, ray_t, rec);
+  }
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override;
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override;
+  [[nodiscard]] auto deterministic_probe() const -> bool override;
   [[nodiscard]] auto bounding_box() const -> aabb override;
   auto printTree(std::ostream &os, const bvh_node &m, int type, const std::string &prefix = "")
       -> void {
@@ -59,6 +77,14 @@ public:
     // }
   }
   auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
+    if (is_leaf()) {
+      os << prefix << "|--[bvh_leaf]: " << prims.size() << "\n";
+      for (auto const &p : prims) {
+        p->print(os, prefix + "  |-");
+        os << "\n";
+      }
+      return;
+    }
     os << prefix << "|--[bvh_node]\n";
     auto left_prefix = prefix + "L";
     if (left != nullptr)
@@ -73,6 +99,10 @@ public:
       os << "null";
   }
   friend auto operator<<(std::ostream &os, const bvh_node &m) -> std::ostream & {
+    if (m.is_leaf()) {
+      m.print(os);
+      return os;
+    }
     os << "|--[bvh_node]\n";
     std::string prefix_l = "L";
     m.left->print(os, prefix_l);
@@ -81,15 +111,41 @@ public:
     m.right->print(os, prefix_r);
     return os;
   }
+
+private:
+  auto build_children(std::vector<std::unique_ptr<hittable>> &objects, size_t start,
+      size_t mid, size_t end, bvh_split split, int depth) -> void;
 };
-bvh_node::bvh_node(
-    std::vector<std::unique_ptr<hittable>> &src_objects, size_t start, size_t end) {
+bvh_node::bvh_node(std::vector<std::unique_ptr<hittable>> &src_objects, size_t start,
+    size_t end, bvh_split split, int depth) {
   auto &objects = src_objects; // Create a modifiable array of the source scene objects
+  size_t object_span = end - start;
+
+  if (split == bvh_split::SAH) {
+    // SAH 分桶划分，划分点为 start 说明作为叶子代价更低；
+    // 过深时改为对半划分，限制展开成 flat_bvh 后的遍历栈深度
+    auto bound_of = [](const std::unique_ptr<hittable> &p) { return p->bounding_box(); };
+    size_t mid = start;
+    if (depth < bvh_max_depth)
+      mid = sah_partition(objects, start, end, bound_of, axis);
+    else if (object_span > bvh_max_leaf)
+      mid = median_partition(objects, start, end, bound_of, axis);
+    if (mid == start || mid == end) {
+      for (size_t i = start; i < end; ++i) {
+        bbox = aabb(bbox, objects[i]->bounding_box());
+        prims.emplace_back(std::move(objects[i]));
+      }
+      return;
+    }
+    build_children(objects, start, mid, end, split, depth);
+    bbox = surrounding_box(left->bounding_box(), right->bounding_box());
+    return;
+  }
+
   // 随机一个轴，按这个轴排序
-  int axis = random_int(0, 2)();
+  axis = random_int(0, 2)();
   auto comparator = (axis == 0) ? box_x_compare : (axis == 1) ? box_y_compare : box_z_compare;
 
-  size_t object_span = end - start;
   // 根据当前结点大小分类处理，1 为 叶子结点， 2 单独处理
   if (object_span == 1) {
     left = std::move(objects[start]);
@@ -108,26 +164,70 @@ bvh_node::bvh_node(
     std::sort(objects.begin() + start, objects.begin() + end, comparator);
     // 按随机的轴排序后，递归建树
     auto mid = start + object_span / 2;
-    left = std::make_unique<bvh_node>(objects, start, mid);
-    right = std::make_unique<bvh_node>(objects, mid, end);
+    build_children(objects, start, mid, end, split, depth);
   }
 
   bbox = surrounding_box(left->bounding_box(), right->bounding_box());
 }
 
-auto bvh_node::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool {
+// 左右子树处理的区间互不重叠，足够大时左子树交给另一个线程
+auto bvh_node::build_children(std::vector<std::unique_ptr<hittable>> &objects, size_t start,
+    size_t mid, size_t end, bvh_split split, int depth) -> void {
+  if (depth < bvh_parallel_depth() && end - start >= bvh_parallel_span) {
+    auto left_task = std::async(std::launch::async, [&] {
+      return std::make_unique<bvh_node>(objects, start, mid, split, depth + 1);
+    });
+    right = std::make_unique<bvh_node>(objects, mid, end, split, depth + 1);
+    left = left_task.get();
+    return;
+  }
+  left = std::make_unique<bvh_node>(objects, start, mid, split, depth + 1);
+  right = std::make_unique<bvh_node>(objects, mid, end, split, depth + 1);
+}
+
+auto bvh_node::probe(const ray &r, interval ray_t, hit_query &q) const -> bool {
   if (!bbox.hit(r, ray_t))
     return false;
+  // 叶子：逐个求交，不断缩小 t 的范围
+  if (is_leaf()) {
+    bool hit_anything = false;
+    for (const auto &p : prims) {
+      if (p->probe(r, ray_t, q)) {
+        hit_anything = true;
+        ray_t.max = q.t;
+      }
+    }
+    return hit_anything;
+  }
   // 递归查找光线与 AABB 的交
   bool hit_left = false, hit_right = false;
-  hit_left = left->hit(r, ray_t, rec);
+  hit_left = left->probe(r, ray_t, q);
   if (right != nullptr) {
-    hit_right = right->hit(r, interval(ray_t.min, hit_left ? rec.t : ray_t.max), rec);
+    hit_right = right->probe(r, interval(ray_t.min, hit_left ? q.t : ray_t.max), q);
   }
 
   return hit_left || hit_right;
 }
 
+// 找到任意一个交点即返回，不需要按远近顺序访问儿子
+auto bvh_node::occluded(const ray &r, interval ray_t) const -> bool {
+  if (!bbox.hit(r, ray_t))
+    return false;
+  if (is_leaf()) {
+    return std::any_of(
+        prims.begin(), prims.end(), [&](const auto &p) { return p->occluded(r, ray_t); });
+  }
+  return left->occluded(r, ray_t) || (right != nullptr && right->occluded(r, ray_t));
+}
+
+auto bvh_node::deterministic_probe() const -> bool {
+  if (is_leaf()) {
+    return std::all_of(
+        prims.begin(), prims.end(), [](const auto &p) { return p->deterministic_probe(); });
+  }
+  return left->deterministic_probe() && (right == nullptr || right->deterministic_probe());
+}
+
 auto bvh_node::bounding_box() const -> aabb {
   return bbox;
 }
@@ -16,6 +16,8 @@ public:
       : mp(mat), x0(_x0), x1(_x1), y0(_y0), y1(_y1), k(_k){};
 
   auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override;
+  auto finalize(const ray &r, const hit_query &q, hit_record &rec) const -> void override;
 
   [[nodiscard]] auto bounding_box() const -> aabb override {
     // The bounding box must have non-zero width in each dimension, so pad the Z
@@ -23,7 +25,8 @@ public:
     return {point3(x0, y0, k - 0.0001), point3(x1, y1, k + 0.0001)};
   }
   [[nodiscard]] auto random(const point3 &origin) const -> vec3d override {
-    auto random_point = point3(random_double(x0, x1)(), k, random_double(y0, y1)());
+    auto [a, b] = sample_2d();
+    auto random_point = point3(x0 + a * (x1 - x0), k, y0 + b * (y1 - y0));
     return random_point - origin;
   }
   auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
@@ -38,6 +41,13 @@ public:
 };
 
 auto xy_rect::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool {
+  hit_query q;
+  if (!probe(r, ray_t, q))
+    return false;
+  finalize(r, q, rec);
+  return true;
+}
+auto xy_rect::probe(const ray &r, interval ray_t, hit_query &q) const -> bool {
   auto t = (k - r.origin().z()) / r.direction().z();
   if (ray_t.outside(t))
     return false;
@@ -45,14 +55,20 @@ auto xy_rect::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool {
   auto y = r.origin().y() + t * r.direction().y();
   if (x < x0 || x > x1 || y < y0 || y > y1)
     return false;
-  rec.u = (x - x0) / (x1 - x0);
-  rec.v = (y - y0) / (y1 - y0);
-  rec.t = t;
+  q.b1 = (x - x0) / (x1 - x0);
+  q.b2 = (y - y0) / (y1 - y0);
+  q.t = t;
+  q.prim = this;
+  return true;
+}
+auto xy_rect::finalize(const ray &r, const hit_query &q, hit_record &rec) const -> void {
+  rec.u = q.b1;
+  rec.v = q.b2;
+  rec.t = q.t;
   auto outward_normal = vec3d(0, 0, 1);
   rec.set_face_normal(r, outward_normal);
   rec.mat_ptr = mp;
-  rec.p = r.at(t);
-  return true;
+  rec.p = r.at(q.t);
 }
 
 class xz_rect : public hittable {
@@ -67,6 +83,8 @@ public:
       : mp(mat), x0(_x0), x1(_x1), z0(_z0), z1(_z1), k(_k){};
 
   auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override;
+  auto finalize(const ray &r, const hit_query &q, hit_record &rec) const -> void override;
 
   [[nodiscard]] auto bounding_box() const -> aabb override {
     // The bounding box must have non-zero width in each dimension, so pad the Y
@@ -74,7 +92,8 @@ public:
     return {point3(x0, k - 0.0001, z0), point3(x1, k + 0.0001, z1)};
   }
   [[nodiscard]] auto random(const point3 &origin) const -> vec3d override {
-    auto random_point = point3(random_double(x0, x1)(), k, random_double(z0, z1)());
+    auto [a, b] = sample_2d();
+    auto random_point = point3(x0 + a * (x1 - x0), k, z0 + b * (z1 - z0));
     return random_point - origin;
   }
   auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
@@ -89,6 +108,13 @@ public:
 };
 
 auto xz_rect::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool {
+  hit_query q;
+  if (!probe(r, ray_t, q))
+    return false;
+  finalize(r, q, rec);
+  return true;
+}
+auto xz_rect::probe(const ray &r, interval ray_t, hit_query &q) const -> bool {
   auto t = (k - r.origin().y()) / r.direction().y();
   if (ray_t.outside(t))
     return false;
@@ -96,14 +122,20 @@ auto xz_rect::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool {
   auto z = r.origin().z() + t * r.direction().z();
   if (x < x0 || x > x1 || z < z0 || z > z1)
     return false;
-  rec.u = (x - x0) / (x1 - x0);
-  rec.v = (z - z0) / (z1 - z0);
-  rec.t = t;
+  q.b1 = (x - x0) / (x1 - x0);
+  q.b2 = (z - z0) / (z1 - z0);
+  q.t = t;
+  q.prim = this;
+  return true;
+}
+auto xz_rect::finalize(const ray &r, const hit_query &q, hit_record &rec) const -> void {
+  rec.u = q.b1;
+  rec.v = q.b2;
+  rec.t = q.t;
   auto outward_normal = vec3d(0, 1, 0);
   rec.set_face_normal(r, outward_normal);
   rec.mat_ptr = mp;
-  rec.p = r.at(t);
-  return true;
+  rec.p = r.at(q.t);
 }
 
 class yz_rect : public hittable {
@@ -118,6 +150,8 @@ public:
       : mp(mat), y0(_y0), y1(_y1), z0(_z0), z1(_z1), k(_k){};
 
   auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override;
+  auto finalize(const ray &r, const hit_query &q, hit_record &rec) const -> void override;
 
   [[nodiscard]] auto bounding_box() const -> aabb override {
     // The bounding box must have non-zero width in each dimension, so pad the X
@@ -125,7 +159,8 @@ public:
     return {point3(k - 0.0001, y0, z0), point3(k + 0.0001, y1, z1)};
   }
   [[nodiscard]] auto random(const point3 &origin) const -> vec3d override {
-    auto random_point = point3(random_double(y0, y1)(), k, random_double(z0, z1)());
+    auto [a, b] = sample_2d();
+    auto random_point = point3(y0 + a * (y1 - y0), k, z0 + b * (z1 - z0));
     return random_point - origin;
   }
   auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
@@ -140,6 +175,13 @@ public:
 };
 
 auto yz_rect::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool {
+  hit_query q;
+  if (!probe(r, ray_t, q))
+    return false;
+  finalize(r, q, rec);
+  return true;
+}
+auto yz_rect::probe(const ray &r, interval ray_t, hit_query &q) const -> bool {
   auto t = (k - r.origin().x()) / r.direction().x();
   if (ray_t.outside(t))
     return false;
@@ -147,14 +189,20 @@ auto yz_rect::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool {
   auto z = r.origin().z() + t * r.direction().z();
   if (y < y0 || y > y1 || z < z0 || z > z1)
     return false;
-  rec.u = (y - y0) / (y1 - y0);
-  rec.v = (z - z0) / (z1 - z0);
-  rec.t = t;
+  q.b1 = (y - y0) / (y1 - y0);
+  q.b2 = (z - z0) / (z1 - z0);
+  q.t = t;
+  q.prim = this;
+  return true;
+}
+auto yz_rect::finalize(const ray &r, const hit_query &q, hit_record &rec) const -> void {
+  rec.u = q.b1;
+  rec.v = q.b2;
+  rec.t = q.t;
   auto outward_normal = vec3d(1, 0, 0);
   rec.set_face_normal(r, outward_normal);
   rec.mat_ptr = mp;
-  rec.p = r.at(t);
-  return true;
+  rec.p = r.at(q.t);
 }
 
 #endif
\ No newline at end of file
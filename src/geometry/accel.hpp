@@ -0,0 +1,45 @@
+/**
+ * @file accel.hpp
+ * @brief 根据场景配置构建加速结构
+ */
+#ifndef ACCEL_HPP
+#define ACCEL_HPP
+
+#include "BVH.hpp"
+#include "bvh4.hpp"
+#include "flat_bvh.hpp"
+#include "hittablelist.hpp"
+#include "primitive_bvh.hpp"
+
+/**
+ * @brief BVH 的存储形式
+ * Tree : bvh_node 指针树，递归 + 虚函数遍历
+ * Flat : 展平为连续数组，迭代遍历；球、三角形、四边形按类型连续存放，叶子静态分派
+ * Wide : 折叠为 4 叉树，AVX2 一次测试 4 个儿子
+ */
+enum class bvh_layout {
+  Tree,
+  Flat,
+  Wide,
+};
+
+/**
+ * @brief 用 list 中的物体构建 BVH（list 中的物体会被移走）
+ */
+inline auto make_bvh(hittable_list &list, bvh_split split, bvh_layout layout)
+    -> std::unique_ptr<hittable> {
+  switch (layout) {
+  case bvh_layout::Tree:
+    return std::make_unique<bvh_node>(list, split);
+  case bvh_layout::Flat:
+    if (std::any_of(list.objects.begin(), list.objects.end(),
+            [](const auto &object) { return primitive_bvh::packable(*object); }))
+      return std::make_unique<primitive_bvh>(list, split);
+    return std::make_unique<flat_bvh>(list, split);
+  case bvh_layout::Wide:
+    return std::make_unique<bvh4>(list, split);
+  }
+  return nullptr;
+}
+
+#endif
@@ -16,6 +16,12 @@ public:
   box(const point3 &p0, const point3 &p1, material *ptr);
 
   auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override {
+    return sides.probe(r, ray_t, q);
+  }
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override {
+    return sides.occluded(r, ray_t);
+  }
 
   [[nodiscard]] auto bounding_box() const -> aabb override {
     return {box_min, box_max};
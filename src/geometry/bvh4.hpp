@@ -0,0 +1,293 @@
+/**
+ * @file bvh4.hpp
+ * @brief 4 叉 BVH：由二叉 bvh_node 树折叠而来，一次 AVX2 slab 测试 4 个儿子
+ */
+#ifndef BVH4_HPP
+#define BVH4_HPP
+
+#include "../global.hpp"
+#include "../vector/vec3dx4.h"
+#include "BVH.hpp"
+#include "hittable.hpp"
+#include "interval.hpp"
+
+constexpr uint32_t bvh4_leaf_flag = 0x80000000u; // child 的最高位为 1 表示叶子
+constexpr uint32_t bvh4_empty = 0xffffffffu;     // 空的儿子槽位
+constexpr uint32_t bvh4_stack_size = 128; // 每层最多净压栈 3 个，二叉树深度 < 96 时足够
+
+/**
+ * @class bvh4_node
+ * @brief 4 个儿子的包围盒按 SoA 存放，正好放进一个 __m256d
+ *
+ * child[i] 为内部结点下标，或 bvh4_leaf_flag | 图元数组偏移（个数为 count[i]）
+ * 空槽位的包围盒为 [+inf, -inf]，任何光线都不会命中
+ */
+struct alignas(32) bvh4_node {
+  __m256d bmin[3], bmax[3]; // x, y, z
+  std::array<uint32_t, 4> child;
+  std::array<uint16_t, 4> count;
+};
+
+/**
+ * @class bvh4_ray
+ * @brief 光线广播到 4 个通道，同时按方向符号预先选好近/远平面
+ */
+struct bvh4_ray {
+  __m256d orig[3], inv_dir[3];
+  std::array<int, 3> dir_is_neg;
+
+  bvh4_ray(const ray &r) {
+    for (int a = 0; a < 3; ++a) {
+      auto inv = 1.0 / r.direction()[a];
+      orig[a] = _mm256_set1_pd(r.origin()[a]);
+      inv_dir[a] = _mm256_set1_pd(inv);
+      dir_is_neg[a] = inv < 0;
+    }
+  }
+  /**
+   * @brief 同时与 4 个包围盒求交
+   * @param tnear 每个通道的进入距离
+   * @return 命中的通道掩码（低 4 位）
+   */
+  [[nodiscard]] inline auto hit(const bvh4_node &node, double tmin, double tmax,
+      __m256d &tnear) const -> int {
+    auto t_enter = _mm256_set1_pd(tmin);
+    auto t_exit = _mm256_set1_pd(tmax);
+    for (int a = 0; a < 3; ++a) {
+      const auto &near = dir_is_neg[a] ? node.bmax[a] : node.bmin[a];
+      const auto &far = dir_is_neg[a] ? node.bmin[a] : node.bmax[a];
+      auto t0 = _mm256_mul_pd(_mm256_sub_pd(near, orig[a]), inv_dir[a]);
+      auto t1 = _mm256_mul_pd(_mm256_sub_pd(far, orig[a]), inv_dir[a]);
+      // max/min 在有 NaN 时返回第二个操作数，累积值放在第二个保证 NaN 不影响结果
+      t_enter = _mm256_max_pd(t0, t_enter);
+      t_exit = _mm256_min_pd(t1, t_exit);
+    }
+    tnear = t_enter;
+    return _mm256_movemask_pd(_mm256_cmp_pd(t_enter, t_exit, _CMP_LE_OQ));
+  }
+};
+
+/**
+ * @class bvh4
+ * @brief 4 叉宽 BVH，叶子存放在紧凑的图元数组中
+ */
+class bvh4 : public hittable {
+public:
+  std::vector<bvh4_node> nodes;
+  std::vector<std::unique_ptr<hittable>> prims;
+  aabb bbox;
+
+public:
+  bvh4(std::unique_ptr<hittable> tree) {
+    bbox = tree->bounding_box();
+    nodes.reserve(64);
+    // 根结点只有一个儿子时也按 4 叉结点存放，遍历逻辑保持统一
+    std::vector<std::unique_ptr<hittable>> root;
+    root.emplace_back(std::move(tree));
+    collapse(root);
+  }
+  bvh4(hittable_list &list, bvh_split split = bvh_split::SAH)
+      : bvh4(std::make_unique<bvh_node>(list, split)) {}
+
+  auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override {
+    return hit_deferred(*this, r, ray_t, rec);
+  }
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override;
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override;
+  [[nodiscard]] auto deterministic_probe() const -> bool override {
+    return std::all_of(
+        prims.begin(), prims.end(), [](const auto &p) { return p->deterministic_probe(); });
+  }
+  [[nodiscard]] auto bounding_box() const -> aabb override {
+    return bbox;
+  }
+  auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
+    os << prefix << "[bvh4]: nodes = " << nodes.size() << " prims = " << prims.size() << "\n";
+    auto now_prefix = prefix + "  |-";
+    for (auto const &p : prims) {
+      p->print(os, now_prefix);
+      os << "\n";
+    }
+  }
+  friend auto operator<<(std::ostream &os, const bvh4 &m) -> std::ostream & {
+    m.print(os);
+    return os;
+  }
+
+private:
+  // 单儿子的 bvh_node 只是一层包装，直接取出里面的物体
+  static auto unwrap(std::unique_ptr<hittable> h) -> std::unique_ptr<hittable> {
+    while (true) {
+      auto *bvh = dynamic_cast<bvh_node *>(h.get());
+      if (bvh == nullptr || bvh->is_leaf() || bvh->right != nullptr || bvh->left == nullptr)
+        return h;
+      h = std::move(bvh->left);
+    }
+  }
+  static auto is_inner(const std::unique_ptr<hittable> &h) -> bool {
+    auto *bvh = dynamic_cast<bvh_node *>(h.get());
+    return bvh != nullptr && !bvh->is_leaf() && bvh->left != nullptr;
+  }
+  /**
+   * @brief 把一组二叉子树折叠成一个 4 叉结点：不断展开表面积最大的内部结点，直到凑满 4 个
+   * @return 新结点的下标
+   */
+  auto collapse(std::vector<std::unique_ptr<hittable>> &children) -> uint32_t {
+    for (auto &c : children)
+      c = unwrap(std::move(c));
+    while (children.size() < 4) {
+      int best = -1;
+      double best_area = -1;
+      for (size_t i = 0; i < children.size(); ++i) {
+        if (!is_inner(children[i]))
+          continue;
+        auto area = children[i]->bounding_box().surface_area();
+        if (area > best_area)
+          best_area = area, best = static_cast<int>(i);
+      }
+      if (best < 0)
+        break;
+      auto *bvh = dynamic_cast<bvh_node *>(children[best].get());
+      auto l = unwrap(std::move(bvh->left));
+      auto r = unwrap(std::move(bvh->right));
+      children[best] = std::move(l);
+      children.emplace_back(std::move(r));
+    }
+
+    auto index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    std::array<std::array<double, 4>, 3> lo, hi;
+    for (int a = 0; a < 3; ++a) {
+      lo[a].fill(infinity);
+      hi[a].fill(-infinity);
+    }
+    nodes[index].child.fill(bvh4_empty);
+    nodes[index].count.fill(0);
+
+    for (size_t i = 0; i < children.size(); ++i) {
+      auto box = children[i]->bounding_box();
+      for (int a = 0; a < 3; ++a) {
+        lo[a][i] = box.axis[a].min;
+        hi[a][i] = box.axis[a].max;
+      }
+      if (is_inner(children[i])) {
+        auto *bvh = dynamic_cast<bvh_node *>(children[i].get());
+        std::vector<std::unique_ptr<hittable>> grand;
+        grand.emplace_back(std::move(bvh->left));
+        grand.emplace_back(std::move(bvh->right));
+        auto child_index = collapse(grand);
+        nodes[index].child[i] = child_index;
+        continue;
+      }
+      auto offset = static_cast<uint32_t>(prims.size());
+      auto *bvh = dynamic_cast<bvh_node *>(children[i].get());
+      if (bvh != nullptr && bvh->is_leaf()) {
+        nodes[index].count[i] = bvh->prims.size();
+        for (auto &p : bvh->prims)
+          prims.emplace_back(std::move(p));
+      } else if (bvh != nullptr) {
+        // 空树
+        nodes[index].count[i] = 0;
+        lo[0][i] = infinity, hi[0][i] = -infinity;
+      } else {
+        nodes[index].count[i] = 1;
+        prims.emplace_back(std::move(children[i]));
+      }
+      nodes[index].child[i] = bvh4_leaf_flag | offset;
+    }
+    for (int a = 0; a < 3; ++a) {
+      nodes[index].bmin[a] = _mm256_loadu_pd(lo[a].data());
+      nodes[index].bmax[a] = _mm256_loadu_pd(hi[a].data());
+    }
+    return index;
+  }
+};
+
+auto bvh4::probe(const ray &r, interval ray_t, hit_query &q) const -> bool {
+  bvh4_ray br(r);
+  bool hit_anything = false;
+  // 栈中记录结点下标和进入距离，出栈时已比当前最近交点远的直接跳过
+  std::array<std::pair<uint32_t, double>, bvh4_stack_size> stack;
+  uint32_t top = 0;
+  stack[top++] = {0, ray_t.min};
+  alignas(32) std::array<double, 4> tnear;
+  while (top > 0) {
+    auto [index, t_enter] = stack[--top];
+    if (t_enter > ray_t.max)
+      continue;
+    const auto &node = nodes[index];
+    __m256d tn;
+    int mask = br.hit(node, ray_t.min, ray_t.max, tn);
+    if (mask == 0)
+      continue;
+    _mm256_store_pd(tnear.data(), tn);
+    // 命中的儿子按进入距离从远到近压栈，保证先处理近的
+    std::array<int, 4> order;
+    int n = 0;
+    for (int i = 0; i < 4; ++i) {
+      if (!((mask >> i) & 1))
+        continue;
+      int k = n++;
+      while (k > 0 && tnear[order[k - 1]] < tnear[i]) {
+        order[k] = order[k - 1];
+        --k;
+      }
+      order[k] = i;
+    }
+    for (int k = 0; k < n; ++k) {
+      int i = order[k];
+      auto child = node.child[i];
+      if (child & bvh4_leaf_flag) {
+        continue;
+      }
+      assert(top < bvh4_stack_size);
+      stack[top++] = {child, tnear[i]};
+    }
+    // 叶子立即求交（从近到远），可以尽早缩小 ray_t.max
+    for (int k = n - 1; k >= 0; --k) {
+      int i = order[k];
+      auto child = node.child[i];
+      if (!(child & bvh4_leaf_flag) || tnear[i] > ray_t.max)
+        continue;
+      auto offset = child & ~bvh4_leaf_flag;
+      for (uint32_t p = offset; p < offset + node.count[i]; ++p) {
+        if (prims[p]->probe(r, ray_t, q)) {
+          hit_anything = true;
+          ray_t.max = q.t;
+        }
+      }
+    }
+  }
+  return hit_anything;
+}
+
+// 遮挡测试不需要最近交点，命中的儿子不排序，遇到第一个交点就返回
+auto bvh4::occluded(const ray &r, interval ray_t) const -> bool {
+  bvh4_ray br(r);
+  std::array<uint32_t, bvh4_stack_size> stack;
+  uint32_t top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const auto &node = nodes[stack[--top]];
+    __m256d tn;
+    int mask = br.hit(node, ray_t.min, ray_t.max, tn);
+    for (int i = 0; i < 4; ++i) {
+      if (!((mask >> i) & 1))
+        continue;
+      auto child = node.child[i];
+      if (!(child & bvh4_leaf_flag)) {
+        assert(top < bvh4_stack_size);
+        stack[top++] = child;
+        continue;
+      }
+      auto offset = child & ~bvh4_leaf_flag;
+      for (uint32_t p = offset; p < offset + node.count[i]; ++p) {
+        if (prims[p]->occluded(r, ray_t))
+          return true;
+      }
+    }
+  }
+  return false;
+}
+
+#endif
@@ -0,0 +1,218 @@
+/**
+ * @file bvh_build.hpp
+ * @brief BVH 建树用的划分策略（中位数 / SAH 分桶）
+ */
+#ifndef BVH_BUILD_HPP
+#define BVH_BUILD_HPP
+
+#include "../global.hpp"
+#include "AABB.hpp"
+#include <thread>
+
+/**
+ * @brief BVH 的划分方式
+ * Median : 随机一个轴，按包围盒排序后从中间切开（旧的方式）
+ * SAH    : 表面积启发式，质心分桶后选代价最小的切分，叶子可以存多个物体
+ */
+enum class bvh_split {
+  Median,
+  SAH,
+};
+
+constexpr uint32_t sah_bin_count = 16;       // 每个轴的桶数
+constexpr uint32_t bvh_max_leaf = 4;         // 叶子最多存放的物体数
+constexpr double sah_traversal_cost = 0.125; // 相对于一次求交的遍历代价
+constexpr int bvh_max_depth = 48;            // 超过这个深度后 SAH 改为按个数对半划分
+constexpr size_t bvh_parallel_span = 4096;    // 子树物体数不少于它时另开线程建树
+constexpr size_t sah_parallel_grain = 16384;  // 每个分桶线程至少处理的物体数
+
+/**
+ * @brief 建树可用的线程数（hardware_concurrency 每次调用都要读系统文件，只取一次）
+ */
+inline auto bvh_build_threads() -> uint32_t {
+  static const uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+  return threads;
+}
+
+/**
+ * @brief 建树时最多并行展开的层数，约为 log2(线程数) + 1
+ */
+inline auto bvh_parallel_depth() -> int {
+  static const int depth = [] {
+    int d = 1;
+    for (auto n = bvh_build_threads(); n > 1; n >>= 1)
+      ++d;
+    return d;
+  }();
+  return depth;
+}
+
+/**
+ * @brief 把 [start, end) 切成若干段并行计算，再用 merge 合并各段结果；规模小时直接串行
+ *
+ * @param chunk (begin, end) -> Result
+ * @param merge (Result &, Result &&) -> void
+ */
+template <class Result, class ChunkFunc, class MergeFunc>
+auto parallel_reduce(size_t start, size_t end, size_t grain, ChunkFunc &&chunk,
+    MergeFunc &&merge) -> Result {
+  size_t n = end - start;
+  size_t tasks = std::min<size_t>(bvh_build_threads(), n / grain);
+  if (tasks <= 1)
+    return chunk(start, end);
+  std::vector<std::future<Result>> futures;
+  for (size_t t = 1; t < tasks; ++t)
+    futures.emplace_back(
+        std::async(std::launch::async, chunk, start + n * t / tasks, start + n * (t + 1) / tasks));
+  Result result = chunk(start, start + n / tasks);
+  for (auto &f : futures)
+    merge(result, f.get());
+  return result;
+}
+
+/**
+ * @class sah_bin
+ * @brief 一个桶：落入该桶的物体个数与它们的包围盒
+ */
+struct sah_bin {
+  aabb box;
+  uint32_t count = 0;
+};
+
+/**
+ * @brief 对 items[start, end) 做 SAH 分桶划分
+ *
+ * @param bound_of 取得某个 item 的包围盒
+ * @param axis 返回选中的划分轴
+ * @return 划分点 mid，items 已被重排为 [start, mid) 与 [mid, end)；
+ *         返回 start 表示作为叶子更划算
+ */
+template <class Item, class BoundFunc>
+auto sah_partition(std::vector<Item> &items, size_t start, size_t end, BoundFunc &&bound_of,
+    int &axis) -> size_t {
+  size_t n = end - start;
+  // 第一遍：包围盒与质心包围盒
+  using bounds_pair = std::pair<aabb, aabb>;
+  auto [bounds, centroid_bounds] = parallel_reduce<bounds_pair>(
+      start, end, sah_parallel_grain,
+      [&](size_t l, size_t r) {
+        bounds_pair res;
+        for (size_t i = l; i < r; ++i) {
+          auto box = bound_of(items[i]);
+          res.first = aabb(res.first, box);
+          res.second = aabb(res.second, aabb(box.center()));
+        }
+        return res;
+      },
+      [](bounds_pair &a, bounds_pair &&b) {
+        a.first = aabb(a.first, b.first);
+        a.second = aabb(a.second, b.second);
+      });
+  axis = centroid_bounds.longest_axis();
+  // 质心全部重合，无法按桶划分：少量物体直接做叶子，否则从中间切
+  if (centroid_bounds.axis[axis].size() <= 0) {
+    if (n <= bvh_max_leaf)
+      return start;
+    return start + n / 2;
+  }
+
+  // 第二遍：一次遍历同时填好三个轴的桶
+  std::array<double, 3> k{};
+  for (int a = 0; a < 3; ++a) {
+    auto size = centroid_bounds.axis[a].size();
+    k[a] = size > 0 ? sah_bin_count / size : 0;
+  }
+  using axis_bins = std::array<std::array<sah_bin, sah_bin_count>, 3>;
+  auto all_bins = parallel_reduce<axis_bins>(
+      start, end, sah_parallel_grain,
+      [&](size_t l, size_t r) {
+        axis_bins res;
+        for (size_t i = l; i < r; ++i) {
+          auto box = bound_of(items[i]);
+          auto c = box.center();
+          for (int a = 0; a < 3; ++a) {
+            if (k[a] == 0)
+              continue;
+            auto offset = (c[a] - centroid_bounds.axis[a].min) * k[a];
+            auto b = std::min(sah_bin_count - 1, uint32_t(offset));
+            res[a][b].count++;
+            res[a][b].box = aabb(res[a][b].box, box);
+          }
+        }
+        return res;
+      },
+      [](axis_bins &a, axis_bins &&b) {
+        for (int x = 0; x < 3; ++x)
+          for (uint32_t i = 0; i < sah_bin_count; ++i) {
+            a[x][i].count += b[x][i].count;
+            a[x][i].box = aabb(a[x][i].box, b[x][i].box);
+          }
+      });
+
+  double best_cost = infinity;
+  int best_axis = -1;
+  uint32_t best_bin = 0;
+  for (int a = 0; a < 3; ++a) {
+    if (k[a] == 0)
+      continue;
+    const auto &bins = all_bins[a];
+    // 从右向左扫描，记录右侧的面积与个数
+    std::array<double, sah_bin_count> right_area{};
+    std::array<uint32_t, sah_bin_count> right_count{};
+    aabb acc;
+    uint32_t cnt = 0;
+    for (uint32_t b = sah_bin_count - 1; b > 0; --b) {
+      acc = aabb(acc, bins[b].box);
+      cnt += bins[b].count;
+      right_area[b] = acc.surface_area();
+      right_count[b] = cnt;
+    }
+    acc = aabb();
+    cnt = 0;
+    for (uint32_t b = 0; b + 1 < sah_bin_count; ++b) {
+      acc = aabb(acc, bins[b].box);
+      cnt += bins[b].count;
+      if (cnt == 0 || right_count[b + 1] == 0)
+        continue;
+      double cost = cnt * acc.surface_area() + right_count[b + 1] * right_area[b + 1];
+      if (cost < best_cost) {
+        best_cost = cost, best_axis = a, best_bin = b;
+      }
+    }
+  }
+
+  double parent_area = bounds.surface_area();
+  double split_cost = sah_traversal_cost + best_cost / parent_area;
+  if (best_axis < 0 || (n <= bvh_max_leaf && split_cost >= double(n)))
+    return n <= bvh_max_leaf ? start : start + n / 2;
+
+  axis = best_axis;
+  auto extent_min = centroid_bounds.axis[axis].min;
+  auto mid = std::partition(items.begin() + start, items.begin() + end, [&](const Item &it) {
+    auto c = bound_of(it).center()[axis];
+    return std::min(sah_bin_count - 1, uint32_t((c - extent_min) * k[axis])) <= best_bin;
+  });
+  return mid - items.begin();
+}
+
+/**
+ * @brief 按质心在包围盒最长轴上的中位数对半划分，返回切分点
+ *
+ * SAH 在很深处改用它：每层个数减半，剩下的层数不超过 log2(n)，遍历栈不会溢出
+ */
+template <class Item, class BoundFunc>
+auto median_partition(std::vector<Item> &items, size_t start, size_t end, BoundFunc &&bound_of,
+    int &axis) -> size_t {
+  aabb box;
+  for (size_t i = start; i < end; ++i)
+    box = aabb(box, bound_of(items[i]));
+  axis = box.longest_axis();
+  auto mid = start + (end - start) / 2;
+  std::nth_element(items.begin() + start, items.begin() + mid, items.begin() + end,
+      [&](const Item &a, const Item &b) {
+        return bound_of(a).center()[axis] < bound_of(b).center()[axis];
+      });
+  return mid;
+}
+
+#endif
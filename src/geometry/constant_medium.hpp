@@ -23,6 +23,10 @@ public:
       : boundary(std::move(b)), phase_function(new isotropic(c)), neg_inv_density(-1 / d) {}
 
   auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  // 按密度抽随机数决定散射位置
+  [[nodiscard]] auto deterministic_probe() const -> bool override {
+    return false;
+  }
 
   [[nodiscard]] auto bounding_box() const -> aabb override {
     return boundary->bounding_box();
@@ -0,0 +1,445 @@
+/**
+ * @file flat_bvh.hpp
+ * @brief 展平的 BVH：结点按深度优先顺序存放在连续数组中，迭代遍历
+ */
+#ifndef FLAT_BVH_HPP
+#define FLAT_BVH_HPP
+
+#include "../global.hpp"
+#include "BVH.hpp"
+#include "hittable.hpp"
+#include "interval.hpp"
+#include <bit>
+#include <cfloat>
+#include <cstring>
+#include <limits>
+
+/**
+ * @class linear_bvh_node
+ * @brief 32 字节的线性 BVH 结点
+ *
+ * 包围盒用 float 存储，min 向下、max 向上取整，保证只会比原盒子大
+ * 内部结点：左儿子紧跟在自己后面，second_child 为右儿子下标，prim_count = 0
+ * 叶子结点：[prim_offset, prim_offset + prim_count) 为图元数组中的下标
+ */
+struct alignas(32) linear_bvh_node {
+  std::array<float, 3> bmin, bmax;
+  union {
+    uint32_t prim_offset;
+    uint32_t second_child;
+  };
+  uint16_t prim_count;
+  uint8_t axis;
+  uint8_t pad;
+};
+static_assert(sizeof(linear_bvh_node) == 32, "linear_bvh_node should be 32 bytes");
+
+// 保守地把 aabb 存入 float 包围盒
+inline auto store_bounds(linear_bvh_node &node, const aabb &box) -> void {
+  for (int a = 0; a < 3; ++a) {
+    auto lo = static_cast<float>(box.axis[a].min);
+    auto hi = static_cast<float>(box.axis[a].max);
+    node.bmin[a] = lo > box.axis[a].min ? std::nextafter(lo, -INFINITY) : lo;
+    node.bmax[a] = hi < box.axis[a].max ? std::nextafter(hi, INFINITY) : hi;
+  }
+}
+
+/**
+ * @class bvh_ray
+ * @brief 遍历时每条光线只算一次的数据：起点、方向的倒数、方向的符号
+ */
+struct bvh_ray {
+  std::array<double, 3> orig, inv_dir;
+  std::array<int, 3> dir_is_neg;
+
+  bvh_ray(const ray &r) {
+    for (int a = 0; a < 3; ++a) {
+      orig[a] = r.origin()[a];
+      inv_dir[a] = 1.0 / r.direction()[a];
+      dir_is_neg[a] = inv_dir[a] < 0;
+    }
+  }
+  // slab 测试，NaN（0 * inf）的比较结果为 false，不会缩小区间
+  [[nodiscard]] inline auto hit(const linear_bvh_node &node, double tmin, double tmax) const
+      -> bool {
+    for (int a = 0; a < 3; ++a) {
+      auto t0 = (node.bmin[a] - orig[a]) * inv_dir[a];
+      auto t1 = (node.bmax[a] - orig[a]) * inv_dir[a];
+      if (dir_is_neg[a])
+        std::swap(t0, t1);
+      tmin = t0 > tmin ? t0 : tmin;
+      tmax = t1 < tmax ? t1 : tmax;
+      if (tmax < tmin)
+        return false;
+    }
+    return true;
+  }
+};
+
+/**
+ * @class bvh_ray_f
+ * @brief 单精度的 slab 测试，一次算 3 个轴（SSE）
+ *
+ * 保守舍入：起点舍入到 float 的误差按每轴 |o| * 2^-22 扩大包围盒（换算成 t 上的 pad），
+ * 远端再乘 1 + 2 * gamma(3)；只会多访问结点，不会漏掉相交。第 4 个分量为 NaN，不参与比较
+ */
+struct bvh_ray_f {
+  __m128 orig, inv_dir, pad, neg;
+  std::array<int, 3> dir_is_neg;
+
+  bvh_ray_f(const ray &r) {
+    alignas(16) std::array<float, 4> o{}, inv{}, p{}, n{};
+    for (int a = 0; a < 3; ++a) {
+      o[a] = static_cast<float>(r.origin()[a]);
+      inv[a] = static_cast<float>(1.0 / r.direction()[a]);
+      dir_is_neg[a] = inv[a] < 0;
+      p[a] = (std::abs(o[a]) * 0x1p-22f + FLT_MIN) * std::abs(inv[a]);
+      n[a] = dir_is_neg[a] ? -0.0f : 0.0f;
+    }
+    inv[3] = std::numeric_limits<float>::quiet_NaN();
+    orig = _mm_load_ps(o.data()), inv_dir = _mm_load_ps(inv.data());
+    pad = _mm_load_ps(p.data()), neg = _mm_load_ps(n.data());
+  }
+  [[nodiscard]] inline auto hit(const linear_bvh_node &node, double tmin, double tmax) const
+      -> bool {
+    constexpr float gamma3 = 3 * (FLT_EPSILON / 2) / (1 - 3 * (FLT_EPSILON / 2));
+    // bmin 与 bmax 在结点中相邻，各读 4 个 float，第 4 个分量乘 NaN 后不起作用
+    auto t0 = (_mm_loadu_ps(node.bmin.data()) - orig) * inv_dir;
+    auto t1 = (_mm_loadu_ps(node.bmax.data()) - orig) * inv_dir;
+    auto t_near = _mm_blendv_ps(t0, t1, neg) - pad;
+    auto t_far = (_mm_blendv_ps(t1, t0, neg) + pad) * (1 + 2 * gamma3);
+    // max/min 的任一操作数为 NaN 时返回第二个操作数，所以 NaN 分量不会缩小区间
+    auto lo = _mm_max_ps(t_near, _mm_set1_ps(static_cast<float>(tmin) * (1 - FLT_EPSILON)));
+    auto hi = _mm_min_ps(t_far, _mm_set1_ps(static_cast<float>(tmax) * (1 + FLT_EPSILON)));
+    lo = _mm_max_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_max_ss(lo, _mm_shuffle_ps(lo, lo, 1));
+    hi = _mm_min_ps(hi, _mm_movehl_ps(hi, hi));
+    hi = _mm_min_ss(hi, _mm_shuffle_ps(hi, hi, 1));
+    return _mm_cvtss_f32(lo) <= _mm_cvtss_f32(hi);
+  }
+};
+
+// 编译选项 RT_FLOAT_BVH 打开时遍历使用单精度的 slab 测试
+#ifdef RT_FLOAT_BVH
+using flat_bvh_ray = bvh_ray_f;
+#else
+using flat_bvh_ray = bvh_ray;
+#endif
+
+// 建树深度不超过 bvh_max_depth + log2(图元数) < 96，每层最多压栈一个结点
+constexpr uint32_t flat_bvh_stack_size = 96;
+
+/**
+ * @class bvh_packet
+ * @brief 光线包的 slab 测试：SSE 的 4 个分量对应包中的 4 条光线，一次测试一个结点
+ *
+ * 每条光线的保守舍入与 bvh_ray_f 相同；无效的光线区间为空，永远不命中。
+ * 儿子的访问顺序按第一条有效光线的方向决定，方向不一致时只是多访问结点，结果不变
+ */
+struct bvh_packet {
+  __m128 orig[3], inv_dir[3], pad[3], neg[3]; // 按轴存放（std::array 会丢掉对齐属性）
+  __m128 tmin, tmax;
+  std::array<int, 3> dir_is_neg{};
+
+  bvh_packet(const ray_packet &p) {
+    static_assert(packet_width == 4, "bvh_packet holds one ray per SSE lane");
+    alignas(16) std::array<std::array<float, 4>, 3> o{}, inv{}, pd{}, n{};
+    alignas(16) std::array<float, 4> lo{}, hi{};
+    int lead = p.active != 0 ? std::countr_zero(p.active) : 0;
+    for (uint32_t k = 0; k < packet_width; ++k) {
+      const auto &r = p.rays[k];
+      for (int a = 0; a < 3; ++a) {
+        o[a][k] = static_cast<float>(r.origin()[a]);
+        inv[a][k] = static_cast<float>(1.0 / r.direction()[a]);
+        pd[a][k] = (std::abs(o[a][k]) * 0x1p-22f + FLT_MIN) * std::abs(inv[a][k]);
+        n[a][k] = inv[a][k] < 0 ? -0.0f : 0.0f;
+        if (int(k) == lead)
+          dir_is_neg[a] = inv[a][k] < 0;
+      }
+      if (p.active >> k & 1) {
+        lo[k] = static_cast<float>(p.ray_t[k].min) * (1 - FLT_EPSILON);
+        hi[k] = static_cast<float>(p.ray_t[k].max) * (1 + 2 * FLT_EPSILON);
+      } else {
+        lo[k] = INFINITY, hi[k] = -INFINITY;
+      }
+    }
+    for (int a = 0; a < 3; ++a) {
+      orig[a] = _mm_load_ps(o[a].data()), inv_dir[a] = _mm_load_ps(inv[a].data());
+      pad[a] = _mm_load_ps(pd[a].data()), neg[a] = _mm_load_ps(n[a].data());
+    }
+    tmin = _mm_load_ps(lo.data()), tmax = _mm_load_ps(hi.data());
+  }
+  // 第 k 条光线找到更近的交点后缩小它的区间
+  inline auto shrink(uint32_t k, double t) -> void {
+    tmax[k] = static_cast<float>(t) * (1 + 2 * FLT_EPSILON);
+  }
+  // 返回与结点包围盒相交的光线的位掩码
+  [[nodiscard]] inline auto hit(const linear_bvh_node &node) const -> uint32_t {
+    constexpr float gamma3 = 3 * (FLT_EPSILON / 2) / (1 - 3 * (FLT_EPSILON / 2));
+    auto lo = tmin, hi = tmax;
+    for (int a = 0; a < 3; ++a) {
+      auto t0 = (_mm_set1_ps(node.bmin[a]) - orig[a]) * inv_dir[a];
+      auto t1 = (_mm_set1_ps(node.bmax[a]) - orig[a]) * inv_dir[a];
+      auto t_near = _mm_blendv_ps(t0, t1, neg[a]) - pad[a];
+      auto t_far = (_mm_blendv_ps(t1, t0, neg[a]) + pad[a]) * (1 + 2 * gamma3);
+      // NaN 作为第一个操作数时返回第二个，不会缩小区间
+      lo = _mm_max_ps(t_near, lo);
+      hi = _mm_min_ps(t_far, hi);
+    }
+    return _mm_movemask_ps(_mm_cmple_ps(lo, hi));
+  }
+};
+
+/**
+ * @brief 线性 BVH 的迭代遍历，显式栈 + 按光线方向先访问近的儿子
+ *
+ * @param leaf 叶子回调 (prim_offset, prim_count, ray_t) -> bool，命中时需缩小 ray_t.max
+ * @tparam AnyHit 为 true 时叶子第一次返回 true 就结束遍历（遮挡测试）
+ */
+template <bool AnyHit = false, class LeafFunc>
+inline auto traverse_flat_bvh(const linear_bvh_node *nodes, const ray &r, interval ray_t,
+    LeafFunc &&leaf) -> bool {
+  flat_bvh_ray br(r);
+  bool hit_anything = false;
+  std::array<uint32_t, flat_bvh_stack_size> stack;
+  uint32_t top = 0, current = 0;
+  while (true) {
+    const auto &node = nodes[current];
+    if (br.hit(node, ray_t.min, ray_t.max)) {
+      if (node.prim_count > 0) {
+        if (leaf(node.prim_offset, node.prim_count, ray_t)) {
+          if constexpr (AnyHit)
+            return true;
+          hit_anything = true;
+        }
+        if (top == 0)
+          break;
+        current = stack[--top];
+      } else if (br.dir_is_neg[node.axis]) {
+        assert(top < flat_bvh_stack_size);
+        stack[top++] = current + 1;
+        current = node.second_child;
+      } else {
+        assert(top < flat_bvh_stack_size);
+        stack[top++] = node.second_child;
+        current = current + 1;
+      }
+    } else {
+      if (top == 0)
+        break;
+      current = stack[--top];
+    }
+  }
+  return hit_anything;
+}
+
+/**
+ * @brief 光线包的迭代遍历：只要包中有光线与结点相交就继续向下
+ *
+ * @param leaf 叶子回调 (prim_offset, prim_count, mask)，mask 为与叶子相交的光线；
+ *        某条光线命中时回调需调用 bp.shrink() 缩小它的区间
+ */
+template <class LeafFunc>
+inline auto traverse_flat_bvh_packet(const linear_bvh_node *nodes, bvh_packet &bp,
+    LeafFunc &&leaf) -> void {
+  std::array<uint32_t, flat_bvh_stack_size> stack;
+  uint32_t top = 0, current = 0;
+  while (true) {
+    const auto &node = nodes[current];
+    auto mask = bp.hit(node);
+    if (mask != 0 && node.prim_count > 0) {
+      leaf(node.prim_offset, node.prim_count, mask);
+    } else if (mask != 0) {
+      assert(top < flat_bvh_stack_size);
+      if (bp.dir_is_neg[node.axis]) {
+        stack[top++] = current + 1;
+        current = node.second_child;
+      } else {
+        stack[top++] = node.second_child;
+        current = current + 1;
+      }
+      continue;
+    }
+    if (top == 0)
+      break;
+    current = stack[--top];
+  }
+}
+
+/**
+ * @brief 直接在图元下标数组上建线性 BVH，不经过 bvh_node 树
+ *
+ * 与 bvh_node 相同的策略：SAH 或中位数划分，靠近根的大子树并行构建后再拼接。
+ * 建完后 ids 按叶子顺序排列，叶子的 prim_offset 为 ids 中的位置
+ * @param boxes 每个图元的包围盒，按图元下标索引
+ */
+inline auto build_linear_bvh(std::vector<uint32_t> &ids, const std::vector<aabb> &boxes,
+    size_t start, size_t end, bvh_split split, std::vector<linear_bvh_node> &out, int depth = 0)
+    -> void {
+  auto index = static_cast<uint32_t>(out.size());
+  out.emplace_back();
+  std::memset(&out[index], 0, sizeof(linear_bvh_node));
+  aabb box;
+  for (size_t i = start; i < end; ++i)
+    box = aabb(box, boxes[ids[i]]);
+  store_bounds(out[index], box);
+
+  auto bound_of = [&boxes](uint32_t prim) { return boxes[prim]; };
+  size_t n = end - start, mid = start;
+  int axis = 0;
+  if (split == bvh_split::SAH && depth < bvh_max_depth)
+    mid = sah_partition(ids, start, end, bound_of, axis);
+  else if (n > bvh_max_leaf)
+    mid = median_partition(ids, start, end, bound_of, axis);
+  if (mid == start || mid == end) {
+    out[index].prim_offset = start;
+    out[index].prim_count = n;
+    return;
+  }
+  out[index].axis = axis;
+
+  if (depth < bvh_parallel_depth() && n >= bvh_parallel_span) {
+    // 左子树在另一个线程中建到独立的数组里，完成后接在当前结点后面
+    std::vector<linear_bvh_node> left_nodes, right_nodes;
+    auto left_task = std::async(std::launch::async,
+        [&] { build_linear_bvh(ids, boxes, start, mid, split, left_nodes, depth + 1); });
+    build_linear_bvh(ids, boxes, mid, end, split, right_nodes, depth + 1);
+    left_task.get();
+    auto append = [&](const std::vector<linear_bvh_node> &sub) {
+      auto offset = static_cast<uint32_t>(out.size());
+      for (auto node : sub) {
+        if (node.prim_count == 0)
+          node.second_child += offset;
+        out.push_back(node);
+      }
+      return offset;
+    };
+    append(left_nodes);
+    out[index].second_child = append(right_nodes);
+    return;
+  }
+  build_linear_bvh(ids, boxes, start, mid, split, out, depth + 1);
+  auto second = static_cast<uint32_t>(out.size());
+  build_linear_bvh(ids, boxes, mid, end, split, out, depth + 1);
+  out[index].second_child = second;
+}
+
+/**
+ * @class flat_bvh
+ * @brief bvh_node 树的编译形式：连续的 32 字节结点 + 紧凑的图元数组
+ */
+class flat_bvh : public hittable {
+public:
+  std::vector<linear_bvh_node> nodes;
+  std::vector<std::unique_ptr<hittable>> prims;
+  aabb bbox;
+
+public:
+  flat_bvh(std::unique_ptr<hittable> tree) {
+    bbox = tree->bounding_box();
+    flatten(std::move(tree));
+  }
+  flat_bvh(hittable_list &list, bvh_split split = bvh_split::SAH)
+      : flat_bvh(std::make_unique<bvh_node>(list, split)) {}
+
+  auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override {
+    return hit_deferred(*this, r, ray_t, rec);
+  }
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override {
+    return traverse_flat_bvh(nodes.data(), r, ray_t,
+        [&](uint32_t offset, uint32_t count, interval &t) -> bool {
+          bool hit_anything = false;
+          for (uint32_t i = offset; i < offset + count; ++i) {
+            if (prims[i]->probe(r, t, q)) {
+              hit_anything = true;
+              t.max = q.t;
+            }
+          }
+          return hit_anything;
+        });
+  }
+  // 叶子中的物体收到只含与叶子相交的光线的子包
+  auto probe_packet(ray_packet &packet, packet_queries &q) const -> uint32_t override {
+    bvh_packet bp(packet);
+    uint32_t hits = 0, active = packet.active;
+    traverse_flat_bvh_packet(nodes.data(), bp,
+        [&](uint32_t offset, uint32_t count, uint32_t mask) {
+          packet.active = active & mask;
+          for (uint32_t i = offset; i < offset + count; ++i) {
+            auto hit = prims[i]->probe_packet(packet, q);
+            for (uint32_t k = 0; k < packet_width; ++k) {
+              if (hit >> k & 1)
+                bp.shrink(k, q[k].t);
+            }
+            hits |= hit;
+          }
+        });
+    packet.active = active;
+    return hits;
+  }
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override {
+    return traverse_flat_bvh<true>(nodes.data(), r, ray_t,
+        [&](uint32_t offset, uint32_t count, interval &t) -> bool {
+          for (uint32_t i = offset; i < offset + count; ++i) {
+            if (prims[i]->occluded(r, t))
+              return true;
+          }
+          return false;
+        });
+  }
+  [[nodiscard]] auto deterministic_probe() const -> bool override {
+    return std::all_of(
+        prims.begin(), prims.end(), [](const auto &p) { return p->deterministic_probe(); });
+  }
+  [[nodiscard]] auto bounding_box() const -> aabb override {
+    return bbox;
+  }
+  auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
+    os << prefix << "[flat_bvh]: nodes = " << nodes.size() << " prims = " << prims.size()
+       << "\n";
+    auto now_prefix = prefix + "  |-";
+    for (auto const &p : prims) {
+      p->print(os, now_prefix);
+      os << "\n";
+    }
+  }
+  friend auto operator<<(std::ostream &os, const flat_bvh &m) -> std::ostream & {
+    m.print(os);
+    return os;
+  }
+
+private:
+  // 深度优先展平，返回该子树根结点的下标
+  auto flatten(std::unique_ptr<hittable> h) -> uint32_t {
+    auto index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    std::memset(&nodes[index], 0, sizeof(linear_bvh_node));
+    store_bounds(nodes[index], h->bounding_box());
+
+    auto *bvh = dynamic_cast<bvh_node *>(h.get());
+    if (bvh == nullptr) {
+      // 普通物体：单个图元的叶子
+      nodes[index].prim_offset = prims.size();
+      nodes[index].prim_count = 1;
+      prims.emplace_back(std::move(h));
+    } else if (bvh->is_leaf()) {
+      nodes[index].prim_offset = prims.size();
+      nodes[index].prim_count = bvh->prims.size();
+      for (auto &p : bvh->prims)
+        prims.emplace_back(std::move(p));
+    } else if (bvh->left == nullptr) {
+      // 空树：包围盒为空，不会被击中
+    } else if (bvh->right == nullptr) {
+      // 只有一个儿子（中位数建树时的单物体结点）
+      nodes.pop_back();
+      return flatten(std::move(bvh->left));
+    } else {
+      nodes[index].axis = bvh->axis;
+      flatten(std::move(bvh->left));
+      nodes[index].second_child = flatten(std::move(bvh->right));
+    }
+    return index;
+  }
+};
+
+#endif
@@ -18,6 +18,12 @@ public:
     return true;
   }
 
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override {
+    return ptr->occluded(r, ray_t);
+  }
+  [[nodiscard]] auto deterministic_probe() const -> bool override {
+    return ptr->deterministic_probe();
+  }
   [[nodiscard]] auto bounding_box() const -> aabb override {
     return ptr->bounding_box();
   }
@@ -29,14 +29,96 @@ struct hit_record {
     normal = front_face ? outward_normal : -outward_normal;
   }
 };
+
+class hittable;
+/**
+ * @class hit_query
+ * @brief 两阶段求交的第一阶段结果：遍历时只记录 t、图元和重心坐标
+ *
+ * 最近的交点确定之后，才由 prim->finalize() 计算一次交点、法线、纹理坐标和材质
+ * 没有实现两阶段求交的物体（如变换、体积）直接把完整结果写入 rec，并把 prim 置空
+ */
+struct hit_query {
+  double t = 0;
+  double b1 = 0, b2 = 0;          // 重心坐标 / 平面参数坐标
+  uint32_t index = 0;             // 图元内部的下标（网格中的三角形）
+  const hittable *prim = nullptr; // 需要补全表面信息的图元，nullptr 表示 rec 已经完整
+  hit_record *rec = nullptr;
+};
+
+constexpr uint32_t packet_width = 4; // 光线包中的光线数
+
+/**
+ * @class ray_packet
+ * @brief 一起遍历 BVH 的一组光线（2 * 2 个相邻像素的相机采样），active 的第 k 位表示第 k 条有效
+ */
+struct ray_packet {
+  std::array<ray, packet_width> rays;
+  std::array<interval, packet_width> ray_t;
+  uint32_t active = 0;
+};
+using packet_queries = std::array<hit_query, packet_width>;
+
 /**
  * @class hittable
  * @brief 可与光线交互的对象
- * 虚函数：hit()求交, pdf_value()概率密度函数, random()随机
+ * 虚函数：hit()求交, probe() / finalize() 两阶段求交, probe_packet() 光线包求交,
+ *        deterministic_probe() 求交是否不抽随机数, occluded()遮挡测试,
+ *        pdf_value()概率密度函数, random()随机
  */
 class hittable {
 public:
   virtual auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool = 0;
+  /**
+   * @brief 第一阶段：求 ray_t 内最近的交点，命中时写入 q 并返回 true
+   *
+   * 默认直接调用 hit()，先写到临时记录中，没命中时不会破坏 q.rec 中已有的结果
+   */
+  virtual auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool {
+    hit_record tmp;
+    if (!hit(r, ray_t, tmp))
+      return false;
+    *q.rec = tmp;
+    q.t = tmp.t;
+    q.prim = nullptr;
+    return true;
+  }
+  /**
+   * @brief 光线包的第一阶段：对 active 中的每条光线求最近的交点，命中时写入 q[k]、
+   *        缩小 packet.ray_t[k].max，返回命中的光线的位掩码
+   *
+   * 默认逐条调用 probe()；BVH 和网格重写为整包遍历
+   */
+  virtual auto probe_packet(ray_packet &packet, packet_queries &q) const -> uint32_t {
+    uint32_t hits = 0;
+    for (uint32_t k = 0; k < packet_width; ++k) {
+      if ((packet.active >> k & 1) && probe(packet.rays[k], packet.ray_t[k], q[k])) {
+        hits |= 1u << k;
+        packet.ray_t[k].max = q[k].t;
+      }
+    }
+    return hits;
+  }
+  /**
+   * @brief 第二阶段：根据 probe() 记下的信息补全 rec
+   */
+  virtual auto finalize([[maybe_unused]] const ray &r, [[maybe_unused]] const hit_query &q,
+      [[maybe_unused]] hit_record &rec) const -> void {}
+  /**
+   * @brief 求交（hit / probe / probe_packet）是否不抽随机数；容器由子物体决定
+   *
+   * 为 false 时渲染器不打光线包，逐条光线在自己的随机数状态下求交
+   */
+  [[nodiscard]] virtual auto deterministic_probe() const -> bool {
+    return true;
+  }
+  /**
+   * @brief 遮挡测试：ray_t 内有任意交点即返回 true，不需要最近交点和表面信息
+   */
+  [[nodiscard]] virtual auto occluded(const ray &r, interval ray_t) const -> bool {
+    hit_record rec;
+    return hit(r, ray_t, rec);
+  }
   [[nodiscard]] virtual auto bounding_box() const -> aabb = 0;
   [[nodiscard]] virtual auto pdf_value(
       [[maybe_unused]] const point3 &o, [[maybe_unused]] const vec3d &v) const -> double {
@@ -49,6 +131,39 @@ public:
   virtual ~hittable() = default;
 };
 
+/**
+ * @brief 两阶段求交：先 probe() 找到最近的交点，再只为它 finalize() 一次
+ */
+inline auto hit_deferred(const hittable &obj, const ray &r, interval ray_t, hit_record &rec)
+    -> bool {
+  hit_query q;
+  q.rec = &rec;
+  if (!obj.probe(r, ray_t, q))
+    return false;
+  if (q.prim != nullptr)
+    q.prim->finalize(r, q, rec);
+  return true;
+}
+
+/**
+ * @brief 光线包的两阶段求交，返回命中的光线的位掩码，命中的 rec[k] 为完整结果
+ *
+ * 渲染器在整包的相机光线都生成之后才调用这里，再逐条恢复随机数状态着色，
+ * 所以只能用于 deterministic_probe() 为 true 的物体，否则结果会与逐条追踪不同
+ */
+inline auto hit_packet(const hittable &obj, ray_packet &packet,
+    std::array<hit_record, packet_width> &rec) -> uint32_t {
+  packet_queries q;
+  for (uint32_t k = 0; k < packet_width; ++k)
+    q[k].rec = &rec[k];
+  auto hits = obj.probe_packet(packet, q);
+  for (uint32_t k = 0; k < packet_width; ++k) {
+    if ((hits >> k & 1) && q[k].prim != nullptr)
+      q[k].prim->finalize(packet.rays[k], q[k], rec[k]);
+  }
+  return hits;
+}
+
 auto operator<<(std::ostream &os, const hittable &obj) -> std::ostream & {
   obj.print(os);
   return os;
@@ -32,7 +32,24 @@ public:
     objects.emplace_back(std::move(object));
   }
 
-  auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override {
+    return hit_deferred(*this, r, ray_t, rec);
+  }
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override;
+  auto probe_packet(ray_packet &packet, packet_queries &q) const -> uint32_t override {
+    uint32_t hits = 0;
+    for (const auto &object : objects)
+      hits |= object->probe_packet(packet, q);
+    return hits;
+  }
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override {
+    return std::any_of(objects.begin(), objects.end(),
+        [&](const auto &object) { return object->occluded(r, ray_t); });
+  }
+  [[nodiscard]] auto deterministic_probe() const -> bool override {
+    return std::all_of(objects.begin(), objects.end(),
+        [](const auto &object) { return object->deterministic_probe(); });
+  }
   [[nodiscard]] auto bounding_box() const -> aabb override {
     return bbox;
   };
@@ -55,7 +72,8 @@ public:
       exit(-1);
     }
 #endif
-    return objects[(uint32_t)random_int(0, int_size - 1)()]->random(o);
+    auto k = std::min(int_size - 1, static_cast<int>(sample_1d() * int_size));
+    return objects[k]->random(o);
   }
   auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
     os << prefix << "[hit_list]: " << objects.size() << "\n";
@@ -76,16 +94,13 @@ public:
   }
 };
 
-auto hittable_list::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool {
-  hit_record temp_rec;
+auto hittable_list::probe(const ray &r, interval ray_t, hit_query &q) const -> bool {
   bool hit_anything = false;
-  auto closest_so_far = ray_t.max;
   // 遍历列表，查找与光线交的物体，更新最近的交点和 tmax
   for (const auto &object : objects) {
-    if (object->hit(r, interval(ray_t.min, closest_so_far), temp_rec)) {
+    if (object->probe(r, ray_t, q)) {
       hit_anything = true;
-      closest_so_far = temp_rec.t;
-      rec = temp_rec;
+      ray_t.max = q.t;
     }
   }
 
@@ -0,0 +1,174 @@
+/**
+ * @file instance.hpp
+ * @brief 仿射变换实例：一个 3x4 矩阵及其逆矩阵代替多层 translate / scale / rotate 包装
+ */
+#ifndef INSTANCE_HPP
+#define INSTANCE_HPP
+
+#include "../global.hpp"
+#include "hittable.hpp"
+#include "interval.hpp"
+
+/**
+ * @class affine3
+ * @brief 3x4 仿射矩阵 [A | b]，作用于点为 A * p + b，作用于向量为 A * v
+ */
+struct affine3 {
+  std::array<std::array<double, 4>, 3> m = {{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}}};
+
+  static auto translate(const vec3d &offset) -> affine3 {
+    affine3 res;
+    for (int i = 0; i < 3; ++i)
+      res.m[i][3] = offset[i];
+    return res;
+  }
+  static auto scale(const vec3d &s) -> affine3 {
+    affine3 res;
+    for (int i = 0; i < 3; ++i)
+      res.m[i][i] = s[i];
+    return res;
+  }
+  /**
+   * @brief 绕坐标轴 axis（0 = x, 1 = y, 2 = z）按右手定则旋转 angle 度
+   */
+  static auto rotate(int axis, double angle) -> affine3 {
+    auto radians = degrees_to_radians(angle);
+    auto s = sin(radians), c = cos(radians);
+    int a = (axis + 1) % 3, b = (axis + 2) % 3;
+    affine3 res;
+    res.m[a][a] = c, res.m[a][b] = -s;
+    res.m[b][a] = s, res.m[b][b] = c;
+    return res;
+  }
+
+  [[nodiscard]] auto point(const point3 &p) const -> point3 {
+    return {m[0][0] * p[0] + m[0][1] * p[1] + m[0][2] * p[2] + m[0][3],
+        m[1][0] * p[0] + m[1][1] * p[1] + m[1][2] * p[2] + m[1][3],
+        m[2][0] * p[0] + m[2][1] * p[1] + m[2][2] * p[2] + m[2][3]};
+  }
+  [[nodiscard]] auto vector(const vec3d &v) const -> vec3d {
+    return {m[0][0] * v[0] + m[0][1] * v[1] + m[0][2] * v[2],
+        m[1][0] * v[0] + m[1][1] * v[1] + m[1][2] * v[2],
+        m[2][0] * v[0] + m[2][1] * v[1] + m[2][2] * v[2]};
+  }
+  // 乘以线性部分的转置：由逆矩阵变换法线
+  [[nodiscard]] auto transpose_vector(const vec3d &v) const -> vec3d {
+    return {m[0][0] * v[0] + m[1][0] * v[1] + m[2][0] * v[2],
+        m[0][1] * v[0] + m[1][1] * v[1] + m[2][1] * v[2],
+        m[0][2] * v[0] + m[1][2] * v[1] + m[2][2] * v[2]};
+  }
+  // 复合变换：先做 rhs 再做 *this
+  auto operator*(const affine3 &rhs) const -> affine3 {
+    affine3 res;
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 4; ++j) {
+        res.m[i][j] = m[i][0] * rhs.m[0][j] + m[i][1] * rhs.m[1][j] + m[i][2] * rhs.m[2][j];
+      }
+      res.m[i][3] += m[i][3];
+    }
+    return res;
+  }
+  /**
+   * @brief 逆矩阵：线性部分用伴随矩阵求逆，平移为 -A^-1 * b
+   */
+  [[nodiscard]] auto inverse() const -> affine3 {
+    affine3 res;
+    for (int i = 0; i < 3; ++i) {
+      int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+      for (int j = 0; j < 3; ++j) {
+        int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+        res.m[j][i] = m[i1][j1] * m[i2][j2] - m[i1][j2] * m[i2][j1];
+      }
+    }
+    auto det = m[0][0] * res.m[0][0] + m[0][1] * res.m[1][0] + m[0][2] * res.m[2][0];
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 3; ++j)
+        res.m[i][j] /= det;
+    }
+    for (int i = 0; i < 3; ++i)
+      res.m[i][3] = -(res.m[i][0] * m[0][3] + res.m[i][1] * m[1][3] + res.m[i][2] * m[2][3]);
+    return res;
+  }
+};
+
+/**
+ * @class instance
+ * @brief 对物体做一次仿射变换：光线变到物体空间求交，交点和法线再变回世界空间
+ *
+ * 仿射变换不改变光线参数 t，法线用逆矩阵的转置变换后与光线方向的点积符号不变，
+ * 所以 t 和 front_face 直接沿用物体空间的结果
+ */
+class instance : public hittable {
+public:
+  std::unique_ptr<hittable> ptr;
+  affine3 to_world, to_object;
+  aabb bbox;
+
+public:
+  instance(std::unique_ptr<hittable> p, const affine3 &transform)
+      : ptr(std::move(p)), to_world(transform), to_object(transform.inverse()) {
+    // 物体包围盒的 8 个角变换后重新求包围盒
+    auto box = ptr->bounding_box();
+    point3 min(infinity, infinity, infinity);
+    point3 max(-infinity, -infinity, -infinity);
+    for (int i = 0; i < 8; ++i) {
+      point3 corner(i & 1 ? box.x().max : box.x().min, i & 2 ? box.y().max : box.y().min,
+          i & 4 ? box.z().max : box.z().min);
+      auto p = to_world.point(corner);
+      min = merge_min(min, p);
+      max = merge_max(max, p);
+    }
+    bbox = aabb(min, max);
+  }
+
+  auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override {
+    ray local(to_object.point(r.origin()), to_object.vector(r.direction()));
+    if (!ptr->hit(local, ray_t, rec))
+      return false;
+    rec.p = to_world.point(rec.p);
+    rec.normal = unit_vector(to_object.transpose_vector(rec.normal));
+    return true;
+  }
+  // 光线包整体变到物体空间，命中的交点立即补全并变回世界空间
+  auto probe_packet(ray_packet &packet, packet_queries &q) const -> uint32_t override {
+    ray_packet local = packet;
+    for (uint32_t k = 0; k < packet_width; ++k) {
+      const auto &r = packet.rays[k];
+      local.rays[k] = ray(to_object.point(r.origin()), to_object.vector(r.direction()));
+    }
+    auto hits = ptr->probe_packet(local, q);
+    for (uint32_t k = 0; k < packet_width; ++k) {
+      if (!(hits >> k & 1))
+        continue;
+      auto &rec = *q[k].rec;
+      if (q[k].prim != nullptr)
+        q[k].prim->finalize(local.rays[k], q[k], rec);
+      rec.p = to_world.point(rec.p);
+      rec.normal = unit_vector(to_object.transpose_vector(rec.normal));
+      q[k].prim = nullptr;
+      packet.ray_t[k].max = q[k].t;
+    }
+    return hits;
+  }
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override {
+    return ptr->occluded(
+        ray(to_object.point(r.origin()), to_object.vector(r.direction())), ray_t);
+  }
+  [[nodiscard]] auto deterministic_probe() const -> bool override {
+    return ptr->deterministic_probe();
+  }
+  [[nodiscard]] auto bounding_box() const -> aabb override {
+    return bbox;
+  }
+  auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
+    os << prefix << "[instance] ";
+    ptr->print(os, prefix);
+  }
+  friend auto operator<<(std::ostream &os, const instance &t) -> std::ostream & {
+    os << "[instance] ";
+    t.ptr->print(os);
+    return os;
+  }
+};
+
+#endif
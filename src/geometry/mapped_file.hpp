@@ -0,0 +1,95 @@
+/**
+ * @file mapped_file.hpp
+ * @brief 只读内存映射文件与内容哈希，用于网格缓存
+ */
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @class mapped_file
+ * @brief 把整个文件只读映射进内存，析构时解除映射
+ */
+class mapped_file {
+public:
+  mapped_file() = default;
+  explicit mapped_file(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return;
+    struct stat st {};
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+      void *p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        ptr = static_cast<const char *>(p);
+        length = st.st_size;
+      }
+    }
+    ::close(fd); // 映射建立后可以关闭文件
+  }
+  mapped_file(const mapped_file &) = delete;
+  auto operator=(const mapped_file &) -> mapped_file & = delete;
+  ~mapped_file() {
+    if (ptr != nullptr)
+      ::munmap(const_cast<char *>(ptr), length);
+  }
+
+  [[nodiscard]] auto valid() const -> bool {
+    return ptr != nullptr;
+  }
+  [[nodiscard]] auto data() const -> const char * {
+    return ptr;
+  }
+  [[nodiscard]] auto size() const -> size_t {
+    return length;
+  }
+
+private:
+  const char *ptr = nullptr;
+  size_t length = 0;
+};
+
+constexpr uint64_t hash_prime1 = 0x9e3779b185ebca87ULL;
+constexpr uint64_t hash_prime2 = 0xc2b2ae3d27d4eb4fULL;
+constexpr uint64_t hash_prime3 = 0x165667b19e3779f9ULL;
+
+inline auto rotl64(uint64_t x, int r) -> uint64_t {
+  return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * @brief 64 位内容哈希：按 8 字节一组，每组先乘、循环移位再乘后并入（与 xxHash64 的一轮相同），
+ * 最后混入长度并做雪崩，任何一个字节的改动都会扩散到所有位
+ */
+inline auto content_hash(const void *data, size_t size, uint64_t seed = 0) -> uint64_t {
+  const auto *p = static_cast<const unsigned char *>(data);
+  auto round = [](uint64_t h, uint64_t word) {
+    h ^= rotl64(word * hash_prime2, 31) * hash_prime1;
+    return rotl64(h, 27) * hash_prime1 + hash_prime3;
+  };
+  uint64_t h = seed + hash_prime3;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, p + i, 8);
+    h = round(h, word);
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, p + i, size - i);
+  h = round(h, tail) ^ size;
+  h ^= h >> 33;
+  h *= hash_prime2;
+  h ^= h >> 29;
+  h *= hash_prime3;
+  h ^= h >> 32;
+  return h;
+}
+
+#endif
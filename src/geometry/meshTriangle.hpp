@@ -7,7 +7,7 @@
 #include "interval.hpp"
 #include "triangle.hpp"
 
-#include "../external/OBJ_Loader.hpp"
+#include "obj_reader.hpp"
 #include "../material/lambertian.hpp"
 // #include "../material/dielectric.hpp"
 // #include "../material/metal.hpp"
@@ -26,27 +26,34 @@ public:
   MeshTriangle(const std::string &filename, double s = 1.0f,
       material *m = new lambertian(color(1, 0.97255, 0.86275) * 0.75))
       : scale(s), mat_ptr(m) {
-    objl::Loader loader;
-    loader.LoadFile(filename);
-    assert(loader.LoadedMeshes.size() == 1);
-    auto mesh = loader.LoadedMeshes[0];
-    for (uint32_t i = 0; i < mesh.Vertices.size(); i += 3) {
+    obj_data obj;
+    if (!read_obj(filename, obj)) {
+      std::cerr << "can not load mesh " << filename << "\n";
+      return;
+    }
+    // 所有 o / g 分组的面都加入
+    for (const auto &face : obj.faces) {
       std::array<vec3d, 3> face_vertices;
       std::array<pdd, 3> texture;
       for (int j = 0; j < 3; j++) {
-        auto vert = vec3d(mesh.Vertices[i + j].Position.X, mesh.Vertices[i + j].Position.Y,
-                        mesh.Vertices[i + j].Position.Z) *
-                    scale;
-        auto tex = std::make_pair(
-            mesh.Vertices[i + j].TextureCoordinate.X, mesh.Vertices[i + j].TextureCoordinate.Y);
-        face_vertices[j] = vert;
-        texture[j] = tex;
+        const auto &pos = obj.positions[face[j].v];
+        face_vertices[j] = vec3d(pos[0], pos[1], pos[2]) * scale;
+        texture[j] = face[j].vt != obj_no_index
+                         ? std::make_pair<double, double>(
+                               obj.texcoords[face[j].vt][0], obj.texcoords[face[j].vt][1])
+                         : std::make_pair(0.0, 0.0);
       }
       triangles.add(std::make_unique<triangle>(face_vertices, texture, mat_ptr));
     }
     bbox = triangles.bounding_box();
   }
   auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override {
+    return triangles.probe(r, ray_t, q);
+  }
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override {
+    return triangles.occluded(r, ray_t);
+  }
   [[nodiscard]] auto bounding_box() const -> aabb override;
   auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
     os << prefix;
@@ -0,0 +1,302 @@
+/**
+ * @file obj_reader.hpp
+ * @brief 快速 OBJ 读取：mmap 整个文件，from_chars 解析数字，保留下标缓冲区，大文件分块并行解析
+ */
+#ifndef OBJ_READER_HPP
+#define OBJ_READER_HPP
+
+#include "mapped_file.hpp"
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+constexpr uint32_t obj_no_index = UINT32_MAX; // 面的角没有给出纹理坐标或法线
+constexpr size_t obj_parallel_chunk = 1 << 20; // 每个解析线程至少处理的字节数
+
+/**
+ * @class obj_corner
+ * @brief 面的一个角：顶点、纹理坐标、法线在各自数组中的下标（从 0 开始）
+ */
+struct obj_corner {
+  uint32_t v = 0, vt = obj_no_index, vn = obj_no_index;
+};
+
+/**
+ * @class obj_group
+ * @brief o / g 开始的一组面：faces 中的 [first_face, first_face + face_count)
+ */
+struct obj_group {
+  std::string name;
+  uint32_t first_face = 0, face_count = 0;
+};
+
+/**
+ * @class obj_data
+ * @brief OBJ 的原始数据，多边形按扇形切成三角形，不展开下标
+ */
+struct obj_data {
+  std::vector<std::array<float, 3>> positions;
+  std::vector<std::array<float, 2>> texcoords;
+  std::vector<std::array<float, 3>> normals;
+  std::vector<std::array<obj_corner, 3>> faces;
+  std::vector<obj_group> groups;
+};
+
+namespace obj_detail {
+
+inline auto skip_space(const char *p, const char *end) -> const char * {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    ++p;
+  return p;
+}
+inline auto next_line(const char *p, const char *end) -> const char * {
+  while (p < end && *p != '\n')
+    ++p;
+  return p < end ? p + 1 : end;
+}
+inline auto parse_float(const char *&p, const char *end, float &x) -> bool {
+  p = skip_space(p, end);
+  // from_chars 不接受前导 '+'
+  if (p < end && *p == '+')
+    ++p;
+  auto [ptr, ec] = std::from_chars(p, end, x);
+  if (ec != std::errc())
+    return false;
+  p = ptr;
+  return true;
+}
+
+/**
+ * @class chunk
+ * @brief 一段文件的解析结果
+ *
+ * 正下标是全局的，直接减 1；负下标相对于当前已读的数量，先按本段的计数换算，
+ * 并在 local 中记下，合并时再加上前面各段的数量
+ */
+struct chunk {
+  obj_data data;
+  std::vector<uint16_t> local; // 每个面 9 个下标各占 1 位
+  std::vector<uint32_t> group_face; // 每个 group 在本段 faces 中的起点
+  size_t bad_lines = 0;             // 解析失败的 v / vn 行
+};
+
+// 解析失败的 v / vn 行仍然占一个下标，否则后面的下标都会错位；
+// 用 NaN 标记，合并后引用它的面被丢掉（法线按没有给出处理）
+constexpr float bad_value = std::numeric_limits<float>::quiet_NaN();
+
+// 解析一个下标，返回是否为相对下标（需要加上前面各段的计数）
+inline auto parse_index(const char *&p, const char *end, size_t count, uint32_t &out,
+    bool &relative) -> bool {
+  int64_t value = 0;
+  auto [ptr, ec] = std::from_chars(p, end, value);
+  if (ec != std::errc() || value == 0)
+    return false;
+  p = ptr;
+  relative = value < 0;
+  auto index = relative ? int64_t(count) + value : value - 1;
+  // 指到文件开头之前的相对下标记为无效，合并时不再加偏移
+  if (index < 0)
+    index = obj_no_index, relative = false;
+  out = static_cast<uint32_t>(std::min<int64_t>(index, obj_no_index));
+  return true;
+}
+
+inline auto parse_chunk(const char *p, const char *end) -> chunk {
+  chunk c;
+  auto &d = c.data;
+  std::vector<obj_corner> poly;
+  std::vector<uint8_t> poly_local;
+  while (p < end) {
+    p = skip_space(p, end);
+    if (p >= end)
+      break;
+    const char *line = p;
+    if (line[0] == 'v' && line + 1 < end) {
+      if (line[1] == ' ' || line[1] == '\t') {
+        p = line + 1;
+        std::array<float, 3> v{};
+        if (!parse_float(p, end, v[0]) || !parse_float(p, end, v[1]) ||
+            !parse_float(p, end, v[2]))
+          v = {bad_value, bad_value, bad_value}, ++c.bad_lines;
+        d.positions.push_back(v);
+      } else if (line[1] == 't') {
+        p = line + 2;
+        std::array<float, 2> t{};
+        if (parse_float(p, end, t[0]))
+          parse_float(p, end, t[1]);
+        d.texcoords.push_back(t);
+      } else if (line[1] == 'n') {
+        p = line + 2;
+        std::array<float, 3> n{};
+        if (!parse_float(p, end, n[0]) || !parse_float(p, end, n[1]) ||
+            !parse_float(p, end, n[2]))
+          n = {bad_value, bad_value, bad_value}, ++c.bad_lines;
+        d.normals.push_back(n);
+      }
+    } else if (line[0] == 'f' && line + 1 < end && (line[1] == ' ' || line[1] == '\t')) {
+      p = line + 1;
+      poly.clear(), poly_local.clear();
+      while (true) {
+        p = skip_space(p, end);
+        if (p >= end || *p == '\n' || *p == '#')
+          break;
+        obj_corner corner;
+        bool rel = false;
+        uint8_t flags = 0;
+        if (!parse_index(p, end, d.positions.size(), corner.v, rel))
+          break;
+        flags |= rel ? 1 : 0;
+        if (p < end && *p == '/') {
+          ++p;
+          if (p < end && *p != '/' && parse_index(p, end, d.texcoords.size(), corner.vt, rel))
+            flags |= rel ? 2 : 0;
+          if (p < end && *p == '/') {
+            ++p;
+            if (parse_index(p, end, d.normals.size(), corner.vn, rel))
+              flags |= rel ? 4 : 0;
+          }
+        }
+        poly.push_back(corner);
+        poly_local.push_back(flags);
+      }
+      // 扇形三角化（假定多边形是凸的）
+      for (size_t i = 2; i < poly.size(); ++i) {
+        d.faces.push_back({poly[0], poly[i - 1], poly[i]});
+        c.local.push_back(poly_local[0] | poly_local[i - 1] << 3 | poly_local[i] << 6);
+      }
+    } else if ((line[0] == 'o' || line[0] == 'g') && line + 1 < end &&
+               (line[1] == ' ' || line[1] == '\t' || line[1] == '\r' || line[1] == '\n')) {
+      auto name_begin = skip_space(line + 1, end);
+      auto name_end = name_begin;
+      while (name_end < end && *name_end != '\n' && *name_end != '\r')
+        ++name_end;
+      obj_group g;
+      g.name.assign(name_begin, name_end);
+      d.groups.push_back(std::move(g));
+      c.group_face.push_back(d.faces.size());
+    }
+    p = next_line(p, end);
+  }
+  return c;
+}
+
+} // namespace obj_detail
+
+/**
+ * @brief 读入 OBJ 文件；文件较大时按行切成若干块并行解析再合并
+ *
+ * 只读取 v / vt / vn / f / o / g，材质由场景描述指定，忽略 mtllib 和 usemtl；
+ * 引用了不存在或解析失败的顶点的面被丢掉，并在 std::cerr 上报告
+ */
+inline auto read_obj(const std::string &path, obj_data &out, uint32_t threads = 0) -> bool {
+  mapped_file file(path);
+  if (!file.valid())
+    return false;
+  const char *begin = file.data(), *end = begin + file.size();
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  size_t tasks = std::min<size_t>(threads, file.size() / obj_parallel_chunk);
+  tasks = std::max<size_t>(tasks, 1);
+  // 切分点移到下一行的开头
+  std::vector<const char *> cuts = {begin};
+  for (size_t t = 1; t < tasks; ++t) {
+    auto cut = obj_detail::next_line(begin + file.size() * t / tasks, end);
+    cuts.push_back(std::max(cut, cuts.back()));
+  }
+  cuts.push_back(end);
+  std::vector<std::future<obj_detail::chunk>> futures;
+  for (size_t t = 1; t < tasks; ++t)
+    futures.emplace_back(
+        std::async(std::launch::async, obj_detail::parse_chunk, cuts[t], cuts[t + 1]));
+  std::vector<obj_detail::chunk> chunks;
+  chunks.push_back(obj_detail::parse_chunk(cuts[0], cuts[1]));
+  for (auto &f : futures)
+    chunks.push_back(f.get());
+
+  out = obj_data();
+  size_t nv = 0, nt = 0, nn = 0, nf = 0, bad_lines = 0;
+  for (const auto &c : chunks) {
+    nv += c.data.positions.size(), nt += c.data.texcoords.size();
+    nn += c.data.normals.size(), nf += c.data.faces.size();
+    bad_lines += c.bad_lines;
+  }
+  out.positions.reserve(nv), out.texcoords.reserve(nt);
+  out.normals.reserve(nn), out.faces.reserve(nf);
+  // 第一个 o / g 之前的面放在一个无名的组里
+  out.groups.push_back({"", 0, 0});
+  for (auto &c : chunks) {
+    uint32_t v0 = out.positions.size(), t0 = out.texcoords.size(), n0 = out.normals.size();
+    uint32_t f0 = out.faces.size();
+    for (size_t i = 0; i < c.data.faces.size(); ++i) {
+      auto face = c.data.faces[i];
+      auto flags = c.local[i];
+      for (int k = 0; k < 3; ++k, flags >>= 3) {
+        face[k].v += flags & 1 ? v0 : 0;
+        if (face[k].vt != obj_no_index && (flags & 2))
+          face[k].vt += t0;
+        if (face[k].vn != obj_no_index && (flags & 4))
+          face[k].vn += n0;
+      }
+      out.faces.push_back(face);
+    }
+    for (size_t g = 0; g < c.data.groups.size(); ++g)
+      out.groups.push_back({std::move(c.data.groups[g].name), f0 + c.group_face[g], 0});
+    out.positions.insert(out.positions.end(), c.data.positions.begin(), c.data.positions.end());
+    out.texcoords.insert(out.texcoords.end(), c.data.texcoords.begin(), c.data.texcoords.end());
+    out.normals.insert(out.normals.end(), c.data.normals.begin(), c.data.normals.end());
+  }
+  // 引用了不存在或坏顶点的面整个丢掉；纹理坐标、法线越界或是坏的时按没有给出处理。
+  // kept[i] 为前 i 个面中保留的个数，用来平移各组的起点
+  auto finite = [](const auto &a) {
+    for (auto x : a)
+      if (!std::isfinite(x))
+        return false;
+    return true;
+  };
+  std::vector<uint32_t> kept(out.faces.size() + 1);
+  uint32_t count = 0;
+  for (size_t i = 0; i < out.faces.size(); ++i) {
+    kept[i] = count;
+    auto face = out.faces[i];
+    bool valid = true;
+    for (auto &corner : face) {
+      valid = valid && corner.v < out.positions.size() && finite(out.positions[corner.v]);
+      if (corner.vt != obj_no_index && corner.vt >= out.texcoords.size())
+        corner.vt = obj_no_index;
+      if (corner.vn != obj_no_index &&
+          (corner.vn >= out.normals.size() || !finite(out.normals[corner.vn])))
+        corner.vn = obj_no_index;
+    }
+    if (valid)
+      out.faces[count++] = face;
+  }
+  kept.back() = count;
+  if (bad_lines > 0)
+    std::cerr << "obj " << path << ": " << bad_lines << " malformed v / vn lines\n";
+  if (count < out.faces.size())
+    std::cerr << "obj " << path << ": dropped " << out.faces.size() - count
+              << " faces with invalid vertex indices\n";
+  out.faces.resize(count);
+  for (auto &g : out.groups)
+    g.first_face = kept[g.first_face];
+  // 每组到下一组的起点为止；去掉空组
+  std::vector<obj_group> groups;
+  for (size_t g = 0; g < out.groups.size(); ++g) {
+    uint32_t next = g + 1 < out.groups.size() ? out.groups[g + 1].first_face : out.faces.size();
+    out.groups[g].face_count = next - out.groups[g].first_face;
+    if (out.groups[g].face_count > 0)
+      groups.push_back(std::move(out.groups[g]));
+  }
+  out.groups.swap(groups);
+  return !out.positions.empty();
+}
+
+#endif
@@ -0,0 +1,214 @@
+/**
+ * @file primitive_bvh.hpp
+ * @brief 按类型连续存放图元的线性 BVH：球、三角形、四边形各占一个数组，叶子按类型标签静态分派
+ */
+#ifndef PRIMITIVE_BVH_HPP
+#define PRIMITIVE_BVH_HPP
+
+#include "../global.hpp"
+#include "flat_bvh.hpp"
+#include "hittablelist.hpp"
+#include "quad.hpp"
+#include "sphere.hpp"
+#include "triangle.hpp"
+#include <typeinfo>
+
+enum class prim_type : uint32_t {
+  Sphere,
+  Triangle,
+  Quad,
+};
+
+/**
+ * @class prim_ref
+ * @brief 叶子中的图元引用：类型标签 + 在对应数组中的下标
+ */
+struct prim_ref {
+  prim_type type;
+  uint32_t index;
+};
+
+/**
+ * @class primitive_bvh
+ * @brief 同类图元按值存放在各自的数组里，叶子引用 prim_ref
+ *
+ * sphere / triangle / quad 都是 final 类，通过具体类型调用 probe() 时编译器直接静态调用，
+ * 遍历的内层循环中没有虚函数，图元也不再分散在各自的堆内存中。
+ * 其它类型的物体（变换、网格、体积等）另建一棵 flat_bvh
+ */
+class primitive_bvh : public hittable {
+public:
+  std::vector<sphere> spheres;
+  std::vector<triangle> triangles;
+  std::vector<quad> quads;
+  std::vector<prim_ref> refs; // 按叶子顺序排列
+  std::vector<linear_bvh_node> nodes;
+  std::unique_ptr<hittable> others; // 不能按值存放的物体
+  aabb bbox;
+
+public:
+  /**
+   * @brief 用 list 中的物体建树（list 中的物体会被移走）
+   */
+  primitive_bvh(hittable_list &list, bvh_split split = bvh_split::SAH);
+
+  /**
+   * @brief 是否能按值放进类型数组（只认具体类型本身）
+   */
+  static auto packable(const hittable &h) -> bool {
+    const auto &type = typeid(h);
+    return type == typeid(sphere) || type == typeid(triangle) || type == typeid(quad);
+  }
+
+  auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override {
+    return hit_deferred(*this, r, ray_t, rec);
+  }
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override;
+  auto probe_packet(ray_packet &packet, packet_queries &q) const -> uint32_t override;
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override;
+  // 按值存放的球、三角形、四边形求交都不抽随机数
+  [[nodiscard]] auto deterministic_probe() const -> bool override {
+    return others == nullptr || others->deterministic_probe();
+  }
+  [[nodiscard]] auto bounding_box() const -> aabb override {
+    return bbox;
+  }
+  auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
+    os << prefix << "[primitive_bvh]: nodes = " << nodes.size()
+       << " spheres = " << spheres.size() << " triangles = " << triangles.size()
+       << " quads = " << quads.size() << "\n";
+    if (others != nullptr)
+      others->print(os, prefix + "  |-");
+  }
+  friend auto operator<<(std::ostream &os, const primitive_bvh &m) -> std::ostream & {
+    m.print(os);
+    return os;
+  }
+
+private:
+  // 按标签取出具体类型的图元交给 f
+  template <class Func>
+  auto visit(prim_ref ref, Func &&f) const -> bool {
+    switch (ref.type) {
+    case prim_type::Sphere:
+      return f(spheres[ref.index]);
+    case prim_type::Triangle:
+      return f(triangles[ref.index]);
+    case prim_type::Quad:
+      return f(quads[ref.index]);
+    }
+    return false;
+  }
+  [[nodiscard]] auto bounds_of(prim_ref ref) const -> aabb {
+    aabb box;
+    visit(ref, [&](const auto &p) {
+      box = p.bounding_box();
+      return true;
+    });
+    return box;
+  }
+};
+
+primitive_bvh::primitive_bvh(hittable_list &list, bvh_split split) {
+  hittable_list rest;
+  for (auto &object : list.objects) {
+    bbox = aabb(bbox, object->bounding_box());
+    const auto &type = typeid(*object);
+    if (type == typeid(sphere)) {
+      refs.push_back({prim_type::Sphere, static_cast<uint32_t>(spheres.size())});
+      spheres.push_back(std::move(static_cast<sphere &>(*object)));
+    } else if (type == typeid(triangle)) {
+      refs.push_back({prim_type::Triangle, static_cast<uint32_t>(triangles.size())});
+      triangles.push_back(std::move(static_cast<triangle &>(*object)));
+    } else if (type == typeid(quad)) {
+      refs.push_back({prim_type::Quad, static_cast<uint32_t>(quads.size())});
+      quads.push_back(std::move(static_cast<quad &>(*object)));
+    } else {
+      rest.add(std::move(object));
+    }
+  }
+  list.objects.clear();
+  if (!rest.objects.empty())
+    others = std::make_unique<flat_bvh>(rest, split);
+  if (refs.empty())
+    return;
+
+  std::vector<uint32_t> ids(refs.size());
+  std::vector<aabb> boxes(refs.size());
+  for (uint32_t i = 0; i < ids.size(); ++i) {
+    ids[i] = i;
+    boxes[i] = bounds_of(refs[i]);
+  }
+  build_linear_bvh(ids, boxes, 0, ids.size(), split, nodes);
+  // 引用按叶子顺序重排，叶子的 prim_offset 即为 refs 中的位置
+  std::vector<prim_ref> ordered(refs.size());
+  for (size_t i = 0; i < ids.size(); ++i)
+    ordered[i] = refs[ids[i]];
+  refs.swap(ordered);
+}
+
+auto primitive_bvh::probe(const ray &r, interval ray_t, hit_query &q) const -> bool {
+  bool hit_anything = false;
+  if (!nodes.empty()) {
+    hit_anything = traverse_flat_bvh(nodes.data(), r, ray_t,
+        [&](uint32_t offset, uint32_t count, interval &t) -> bool {
+          bool hit_leaf = false;
+          for (uint32_t i = offset; i < offset + count; ++i) {
+            if (visit(refs[i], [&](const auto &p) { return p.probe(r, t, q); })) {
+              hit_leaf = true;
+              t.max = q.t;
+            }
+          }
+          return hit_leaf;
+        });
+  }
+  if (others != nullptr &&
+      others->probe(r, interval(ray_t.min, hit_anything ? q.t : ray_t.max), q))
+    hit_anything = true;
+  return hit_anything;
+}
+
+// 整包遍历类型数组的 BVH，叶子中逐条光线调用具体类型的 probe()
+auto primitive_bvh::probe_packet(ray_packet &packet, packet_queries &q) const -> uint32_t {
+  uint32_t hits = 0;
+  if (!nodes.empty()) {
+    bvh_packet bp(packet);
+    traverse_flat_bvh_packet(nodes.data(), bp,
+        [&](uint32_t offset, uint32_t count, uint32_t mask) {
+          for (; mask != 0; mask &= mask - 1) {
+            auto k = std::countr_zero(mask);
+            const auto &r = packet.rays[k];
+            auto &t = packet.ray_t[k];
+            for (uint32_t i = offset; i < offset + count; ++i) {
+              if (visit(refs[i], [&](const auto &p) { return p.probe(r, t, q[k]); })) {
+                hits |= 1u << k;
+                t.max = q[k].t;
+              }
+            }
+            if (hits >> k & 1)
+              bp.shrink(k, t.max);
+          }
+        });
+  }
+  if (others != nullptr)
+    hits |= others->probe_packet(packet, q);
+  return hits;
+}
+
+auto primitive_bvh::occluded(const ray &r, interval ray_t) const -> bool {
+  if (!nodes.empty()) {
+    bool blocked = traverse_flat_bvh<true>(nodes.data(), r, ray_t,
+        [&](uint32_t offset, uint32_t count, interval &t) -> bool {
+          for (uint32_t i = offset; i < offset + count; ++i) {
+            if (visit(refs[i], [&](const auto &p) { return p.occluded(r, t); }))
+              return true;
+          }
+          return false;
+        });
+    if (blocked)
+      return true;
+  }
+  return others != nullptr && others->occluded(r, ray_t);
+}
+
+#endif
@@ -15,7 +15,7 @@
   aabb::pad() 是给四边形一点点厚度
   hit 判断方法是 hit 三角形判断的拓展
 */
-class quad : public hittable {
+class quad final : public hittable {
 public:
   point3 Q;
   vec3d u, v;
@@ -51,6 +51,35 @@ public:
     3. determining if the hit point lies inside the quad.
   */
   auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override {
+    hit_query q;
+    if (!intersect(r, ray_t, q))
+      return false;
+    finalize(r, q, rec);
+    return true;
+  }
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override {
+    if (!intersect(r, ray_t, q))
+      return false;
+    q.prim = this;
+    return true;
+  }
+  auto finalize(const ray &r, const hit_query &q, hit_record &rec) const -> void override {
+    // Ray hits the 2D shape; set the rest of the hit record.
+    rec.t = q.t;
+    rec.p = r.at(q.t);
+    rec.u = q.b1;
+    rec.v = q.b2;
+    rec.mat_ptr = mat;
+    rec.set_face_normal(r, normal);
+  }
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override {
+    hit_query q;
+    return intersect(r, ray_t, q);
+  }
+  /**
+   * @brief 只求交点距离 q.t 和平面坐标 q.b1, q.b2
+   */
+  auto intersect(const ray &r, interval ray_t, hit_query &q) const -> bool {
     auto denom = dot(normal, r.direction());
 
     // No hit if the ray is parallel to the plane.
@@ -63,47 +92,40 @@ public:
       return false;
 
     // Determine the hit point lies within the planar shape using its plane coordinates.
-    auto intersection = r.at(t);
-    vec3d planar_hitpt_vector = intersection - Q;
+    vec3d planar_hitpt_vector = r.at(t) - Q;
     auto alpha = dot(w, cross(planar_hitpt_vector, v));
     auto beta = dot(w, cross(u, planar_hitpt_vector));
 
-    if (!is_interior(alpha, beta, rec))
+    if (!is_interior(alpha, beta, q))
       return false;
-
-    // Ray hits the 2D shape; set the rest of the hit record and return true.
-
-    rec.t = t;
-    rec.p = intersection;
-    rec.mat_ptr = mat;
-    rec.set_face_normal(r, normal);
-
+    q.t = t;
     return true;
   }
-  virtual auto is_interior(double a, double b, hit_record &rec) const -> bool {
+  virtual auto is_interior(double a, double b, hit_query &q) const -> bool {
     // Given the hit point in plane coordinates, return false if it is outside the
-    // primitive, otherwise set the hit record UV coordinates and return true.
+    // primitive, otherwise record the UV coordinates and return true.
 
     if ((a < 0) || (1 < a) || (b < 0) || (1 < b))
       return false;
 
-    rec.u = a;
-    rec.v = b;
+    q.b1 = a;
+    q.b2 = b;
     return true;
   }
   [[nodiscard]] auto pdf_value(const point3 &origin, const vec3d &v) const -> double override {
-    hit_record rec;
-    if (!this->hit(ray(origin, v), interval(0.001, infinity), rec))
+    hit_query q;
+    if (!intersect(ray(origin, v), interval(0.001, infinity), q))
       return 0;
 
-    auto distance_squared = rec.t * rec.t * v.length_squared();
-    auto cosine = fabs(dot(v, rec.normal) / v.length());
+    auto distance_squared = q.t * q.t * v.length_squared();
+    auto cosine = fabs(dot(v, normal) / v.length());
 
     return distance_squared / (cosine * area);
   }
 
   [[nodiscard]] auto random(const point3 &origin) const -> vec3d override {
-    auto p = Q + (random_double() * u) + (random_double() * v);
+    auto [a, b] = sample_2d();
+    auto p = Q + (a * u) + (b * v);
     return p - origin;
   }
   auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
@@ -15,7 +15,7 @@
  * @brief 光线 sphere {center, radius, material}
  *
  */
-class sphere : public hittable {
+class sphere final : public hittable {
 
 public:
   point3 center;
@@ -32,14 +32,23 @@ public:
   };
 
   auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override {
+    if (!intersect(r, ray_t, q.t))
+      return false;
+    q.prim = this;
+    return true;
+  }
+  auto finalize(const ray &r, const hit_query &q, hit_record &rec) const -> void override;
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override {
+    double root;
+    return intersect(r, ray_t, root);
+  }
   [[nodiscard]] auto bounding_box() const -> aabb override {
     return bbox;
   };
 
   [[nodiscard]] auto pdf_value(const point3 &o, const vec3d &v) const -> double override {
-
-    hit_record rec;
-    if (!this->hit(ray(o, v), interval(0.001, infinity), rec))
+    if (!occluded(ray(o, v), interval(0.001, infinity)))
       return 0;
 
     auto cos_theta_max = sqrt(1 - radius * radius / (center - o).length_squared());
@@ -64,6 +73,10 @@ public:
   }
 
 private:
+  /**
+   * @brief 求 ray_t 内最近的交点距离 root，不计算表面信息
+   */
+  [[nodiscard]] inline auto intersect(const ray &r, interval ray_t, double &root) const -> bool;
   /**
    * @brief 获得纹理坐标
    * @param p 需要映射的点
@@ -84,30 +97,39 @@ private:
   }
 };
 
-auto sphere::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool {
+inline auto sphere::intersect(const ray &r, interval ray_t, double &root) const -> bool {
   vec3d oc = r.origin() - center;
   auto a = r.direction().length_squared();
   auto half_b = dot(oc, r.direction());
   auto c = oc.length_squared() - radius2;
   // 找到在范围内的最近的点
-  double x0, x1, root;
-  if (solveQuadratic_halfb(a, half_b, c, x0, x1)) {
-    if (ray_t.surrounds(x0))
-      root = x0;
-    else if (ray_t.surrounds(x1))
-      root = x1;
-    else
-      return false;
-  } else
+  double x0, x1;
+  if (!solveQuadratic_halfb(a, half_b, c, x0, x1))
     return false;
-  rec.t = root;
+  if (ray_t.surrounds(x0))
+    root = x0;
+  else if (ray_t.surrounds(x1))
+    root = x1;
+  else
+    return false;
+  return true;
+}
+
+auto sphere::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool {
+  hit_query q;
+  if (!intersect(r, ray_t, q.t))
+    return false;
+  finalize(r, q, rec);
+  return true;
+}
+
+auto sphere::finalize(const ray &r, const hit_query &q, hit_record &rec) const -> void {
+  rec.t = q.t;
   rec.p = r.at(rec.t);
   vec3d &&outward_normal = (rec.p - center) / radius;
   rec.set_face_normal(r, outward_normal);
   get_sphere_uv(outward_normal, rec.u, rec.v);
   rec.mat_ptr = mat_ptr;
-
-  return true;
 }
 
 #endif
\ No newline at end of file
@@ -14,6 +14,10 @@ public:
       : ptr(std::move(p)), offset(std::move(displacement)) {}
 
   auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override;
+  [[nodiscard]] auto deterministic_probe() const -> bool override {
+    return ptr->deterministic_probe();
+  }
 
   [[nodiscard]] auto bounding_box() const -> aabb override;
   auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
@@ -39,7 +43,12 @@ auto translate::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool
 }
 
 auto translate::bounding_box() const -> aabb {
-  return ptr->bounding_box().min() + offset;
+  auto box = ptr->bounding_box();
+  return {box.min() + offset, box.max() + offset};
+}
+
+auto translate::occluded(const ray &r, interval ray_t) const -> bool {
+  return ptr->occluded(ray(r.origin() - offset, r.direction()), ray_t);
 }
 
 class scale : public hittable {
@@ -52,6 +61,10 @@ public:
       : ptr(std::move(p)), vec(std::move(coefficient)) {}
 
   auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override;
+  [[nodiscard]] auto deterministic_probe() const -> bool override {
+    return ptr->deterministic_probe();
+  }
 
   [[nodiscard]] auto bounding_box() const -> aabb override;
   auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
@@ -80,6 +93,10 @@ auto scale::bounding_box() const -> aabb {
   return {ptr->bounding_box().min() * vec, ptr->bounding_box().max() * vec};
 }
 
+auto scale::occluded(const ray &r, interval ray_t) const -> bool {
+  return ptr->occluded(ray(r.origin() / vec, r.direction() / vec), ray_t);
+}
+
 class rotate_y : public hittable {
 public:
   std::unique_ptr<hittable> ptr;
@@ -92,6 +109,10 @@ public:
   rotate_y(std::unique_ptr<hittable> p, double angle);
 
   auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override;
+  [[nodiscard]] auto deterministic_probe() const -> bool override {
+    return ptr->deterministic_probe();
+  }
 
   [[nodiscard]] auto bounding_box() const -> aabb override {
     return bbox;
@@ -165,6 +186,15 @@ auto rotate_y::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool
   return true;
 }
 
+auto rotate_y::occluded(const ray &r, interval ray_t) const -> bool {
+  auto rot = [s = sin_theta, c = cos_theta](const vec3d &v) {
+    double r0 = c * v.x() - s * v.z();
+    double r2 = s * v.x() + c * v.z();
+    return vec3d{r0, v.y(), r2};
+  };
+  return ptr->occluded(ray(rot(r.origin()), rot(r.direction())), ray_t);
+}
+
 class rotate_x : public hittable {
 public:
   std::unique_ptr<hittable> ptr;
@@ -177,6 +207,10 @@ public:
   rotate_x(std::unique_ptr<hittable> p, double angle);
 
   auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override;
+  [[nodiscard]] auto deterministic_probe() const -> bool override {
+    return ptr->deterministic_probe();
+  }
 
   [[nodiscard]] auto bounding_box() const -> aabb override {
     return bbox;
@@ -251,6 +285,15 @@ auto rotate_x::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool
   return true;
 }
 
+auto rotate_x::occluded(const ray &r, interval ray_t) const -> bool {
+  auto rot = [s = sin_theta, c = cos_theta](const vec3d &v) {
+    double r1 = c * v.y() - s * v.z();
+    double r2 = s * v.y() + c * v.z();
+    return vec3d{v.x(), r1, r2};
+  };
+  return ptr->occluded(ray(rot(r.origin()), rot(r.direction())), ray_t);
+}
+
 class rotate_z : public hittable {
 public:
   std::unique_ptr<hittable> ptr;
@@ -263,6 +306,10 @@ public:
   rotate_z(std::unique_ptr<hittable> p, double angle);
 
   auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override;
+  [[nodiscard]] auto deterministic_probe() const -> bool override {
+    return ptr->deterministic_probe();
+  }
 
   [[nodiscard]] auto bounding_box() const -> aabb override {
     return bbox;
@@ -337,4 +384,13 @@ auto rotate_z::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool
   return true;
 }
 
+auto rotate_z::occluded(const ray &r, interval ray_t) const -> bool {
+  auto rot = [s = sin_theta, c = cos_theta](const vec3d &v) {
+    double r1 = c * v.y() - s * v.x();
+    double r0 = s * v.y() + c * v.x();
+    return vec3d{r0, r1, v.z()};
+  };
+  return ptr->occluded(ray(rot(r.origin()), rot(r.direction())), ray_t);
+}
+
 #endif
\ No newline at end of file
@@ -6,7 +6,7 @@
 
 using pdd = std::pair<double, double>;
 
-class triangle : public hittable {
+class triangle final : public hittable {
 public:
   /*
     1. 三个点的坐标 V0，V1，V2，1.0 顺时针
@@ -44,6 +44,22 @@ public:
   [[nodiscard]] inline auto getHitPoint(double u, double v) const -> point3;
   inline auto interpolate(double &u, double &v, vec3d &Barycentr, double weight) const -> void;
   auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override;
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override {
+    if (!intersect(r, ray_t, q.t, q.b1, q.b2))
+      return false;
+    q.prim = this;
+    return true;
+  }
+  auto finalize(const ray &r, const hit_query &q, hit_record &rec) const -> void override;
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override {
+    double t, u, v;
+    return intersect(r, ray_t, t, u, v);
+  }
+  /**
+   * @brief Möller Trumbore 求交，只算 t 和重心坐标
+   */
+  [[nodiscard]] inline auto intersect(const ray &r, interval ray_t, double &t, double &u,
+      double &v) const -> bool;
   [[nodiscard]] auto bounding_box() const -> aabb override;
   inline auto getaabb() -> aabb {
     auto ix = interval(std::min({v0[0], v1[0], v2[0]}), std::max({v0[0], v1[0], v2[0]}));
@@ -53,7 +69,8 @@ public:
   }
   [[nodiscard]] auto pdf_value(const point3 &origin, const vec3d &v) const -> double override;
   [[nodiscard]] auto random(const point3 &origin) const -> vec3d override {
-    auto p = v0 + (random_double() * e1) + (random_double() * e2);
+    auto [a, b] = sample_2d();
+    auto p = v0 + (a * e1) + (b * e2);
     return p - origin;
   }
   auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
@@ -84,7 +101,8 @@ inline auto triangle::interpolate(double &u, double &v, vec3d &Barycentr, double
 }
 
 // Möller Trumbore Algorithm 同时求 光线与三角形的交与 u，v
-auto triangle::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool {
+inline auto triangle::intersect(const ray &r, interval ray_t, double &t, double &u,
+    double &v) const -> bool {
   auto s = r.origin() - v0;
   auto s1 = cross(r.direction(), e2);
   auto s2 = cross(s, e1);
@@ -92,20 +110,27 @@ auto triangle::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool
   if (std::abs(D) < esp)
     return false;
   D = 1 / D;
-  auto t = dot(s2, e2) * D;
-  auto u = dot(s1, s) * D;
-  auto v = dot(s2, r.direction()) * D;
+  t = dot(s2, e2) * D;
+  u = dot(s1, s) * D;
+  v = dot(s2, r.direction()) * D;
+  return !(t < ray_t.min || t > ray_t.max || u < esp || v < esp || 1 - u - v < esp);
+}
 
-  if (t < ray_t.min || t > ray_t.max || u < esp || v < esp || 1 - u - v < esp)
+auto triangle::hit(const ray &r, interval ray_t, hit_record &rec) const -> bool {
+  hit_query q;
+  if (!intersect(r, ray_t, q.t, q.b1, q.b2))
     return false;
+  finalize(r, q, rec);
+  return true;
+}
 
-  rec.t = t;
-  rec.p = r.at(t);
+auto triangle::finalize(const ray &r, const hit_query &q, hit_record &rec) const -> void {
+  rec.t = q.t;
+  rec.p = r.at(q.t);
   rec.set_face_normal(r, normal);
-  auto Barycentr = point3(1 - u - v, u, v);
+  auto Barycentr = point3(1 - q.b1 - q.b2, q.b1, q.b2);
   interpolate(rec.u, rec.v, Barycentr, 1.0);
   rec.mat_ptr = mat_ptr;
-  return true;
 }
 
 auto triangle::bounding_box() const -> aabb {
@@ -113,12 +138,12 @@ auto triangle::bounding_box() const -> aabb {
 }
 
 [[nodiscard]] auto triangle::pdf_value(const point3 &origin, const vec3d &v) const -> double {
-  hit_record rec;
-  if (!this->hit(ray(origin, v), interval(0.001, infinity), rec))
+  double t, b1, b2;
+  if (!intersect(ray(origin, v), interval(0.001, infinity), t, b1, b2))
     return 0;
 
-  auto distance_squared = rec.t * rec.t * v.length_squared();
-  auto cosine = fabs(dot(v, rec.normal) / v.length());
+  auto distance_squared = t * t * v.length_squared();
+  auto cosine = fabs(dot(v, normal) / v.length());
   // 三角形面积
   return distance_squared / (cosine * 0.5 * cross(e1, e2).length());
 }
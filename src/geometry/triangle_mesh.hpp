@@ -0,0 +1,649 @@
+/**
+ * @file triangle_mesh.hpp
+ * @brief 带索引的三角网格：顶点、纹理、法线各自放在共享的数组中，三角形只存 3 个下标
+ */
+#ifndef TRIANGLE_MESH_HPP
+#define TRIANGLE_MESH_HPP
+
+#include "../global.hpp"
+#include "../vector/vec3f.h"
+#include "bvh_build.hpp"
+#include "flat_bvh.hpp"
+#include "hittable.hpp"
+#include "interval.hpp"
+#include "mapped_file.hpp"
+#include "obj_reader.hpp"
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+
+// 合并顶点时的键：顶点、纹理坐标、法线下标，以及没有法线时需要面法线的面
+using mesh_vertex_key = std::array<uint32_t, 4>;
+struct mesh_vertex_hash {
+  auto operator()(const mesh_vertex_key &k) const -> size_t {
+    return std::hash<std::string_view>()(
+        std::string_view(reinterpret_cast<const char *>(k.data()), sizeof(k)));
+  }
+};
+
+constexpr uint32_t mesh_cache_magic = 0x434d5452; // "RTMC"
+constexpr uint32_t mesh_cache_version = 3;
+constexpr const char *mesh_cache_default_dir = "rtcache"; // 相对于运行目录，不写进模型目录
+
+/**
+ * @class mesh_cache_header
+ * @brief 网格缓存文件头，之后依次是顶点（float 精度时为 vec3f）、纹理坐标、法线、下标、
+ * BVH 结点、面积前缀和，每段按 64 字节对齐，映射进来后直接使用
+ */
+struct mesh_cache_header {
+  uint32_t magic = mesh_cache_magic;
+  uint32_t version = mesh_cache_version;
+  uint64_t source_hash = 0; // OBJ 文件内容的哈希
+  uint64_t source_size = 0; // OBJ 文件的字节数
+  double scale = 1;
+  uint32_t smooth = 0, split = 0;
+  uint32_t single = 0, pad = 0;
+  uint64_t vertex_count = 0, triangle_count = 0, node_count = 0;
+  std::array<double, 6> bbox{};
+};
+
+/**
+ * @class mesh_buffers
+ * @brief 加载 OBJ 并建树时网格自己持有的数组
+ */
+struct mesh_buffers {
+  std::vector<point3> positions;
+  std::vector<vec3f> positions_f;
+  std::vector<double> tu, tv, nx, ny, nz;
+  std::vector<std::array<uint32_t, 3>> indices;
+  std::vector<linear_bvh_node> nodes;
+  std::vector<double> area_cdf;
+};
+
+/**
+ * @class triangle_mesh
+ * @brief 整个网格作为一个 hittable，内部用网格自己的线性 BVH 加速
+ *
+ * 每个三角形约占 12 字节下标 + 共享顶点 + 约 1 个 BVH 结点的一部分，
+ * 而单独的 triangle 对象约 300 字节。BVH 建好后三角形按叶子顺序重排，叶子直接引用连续的三角形。
+ * 数据通过 span 访问：要么指向自己的 mesh_buffers，要么直接指向映射进来的缓存文件。
+ * single 为 true 时顶点按 float 存放（每个 16 字节），求交先做单精度的保守测试，
+ * 可能相交时再用双精度确认，结果与把顶点舍入到 float 后的双精度求交相同
+ */
+class triangle_mesh : public hittable {
+public:
+  std::span<const point3> positions;                // 顶点坐标
+  std::span<const vec3f> positions_f;               // single 时的顶点坐标
+  std::span<const double> tu, tv;                   // 纹理坐标
+  std::span<const double> nx, ny, nz;               // 顶点法线（只在 smooth 时保存）
+  std::span<const std::array<uint32_t, 3>> indices; // 三角形的顶点下标
+  std::span<const linear_bvh_node> nodes;           // 网格内部的 BVH
+  std::span<const double> area_cdf;                 // 按面积采样（作为光源）用的前缀和
+  material *mat_ptr = nullptr;
+  bool smooth = false;
+  bool single = false;
+  aabb bbox;
+
+public:
+  triangle_mesh() = default;
+  /**
+   * @brief 加载网格；cache_dir 非空时先找 cache_dir 下的 "<OBJ 文件名>.<参数哈希>.rtcache"，
+   * OBJ 内容的哈希一致就直接映射，否则重新建树并写出缓存
+   */
+  triangle_mesh(const std::string &filename, double scale, material *m,
+      bvh_split split = bvh_split::SAH, bool smooth_normal = false,
+      const std::string &cache_dir = "", bool single_precision = false)
+      : mat_ptr(m), smooth(smooth_normal), single(single_precision) {
+    uint64_t source_hash = 0, source_size = 0;
+    std::string cache_path;
+    bool use_cache = !cache_dir.empty();
+    if (use_cache) {
+      mapped_file source(filename);
+      if (source.valid()) {
+        source_hash = content_hash(source.data(), source.size());
+        source_size = source.size();
+      }
+      cache_path = cache_file(cache_dir, filename, scale, split, single);
+      if (source.valid() && load_cache(cache_path, source_hash, source_size, scale, split))
+        return;
+    }
+    obj_data obj;
+    if (!read_obj(filename, obj)) {
+      std::cerr << "can not load mesh " << filename << "\n";
+      return;
+    }
+    owned = std::make_unique<mesh_buffers>();
+    load(obj, scale);
+    build(split);
+    if (use_cache && source_size != 0 &&
+        !save_cache(cache_path, source_hash, source_size, scale, split))
+      std::cerr << "can not write mesh cache " << cache_path << "\n";
+  }
+
+  [[nodiscard]] auto size() const -> size_t {
+    return indices.size();
+  }
+  [[nodiscard]] auto vertex(uint32_t i) const -> point3 {
+    return single ? positions_f[i].to_vec3d() : positions[i];
+  }
+  [[nodiscard]] auto triangle_bounds(uint32_t tri) const -> aabb {
+    const auto &id = indices[tri];
+    return {aabb(vertex(id[0]), vertex(id[1])), aabb(vertex(id[2]))};
+  }
+
+  auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override {
+    return hit_deferred(*this, r, ray_t, rec);
+  }
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override;
+  auto probe_packet(ray_packet &packet, packet_queries &q) const -> uint32_t override;
+  auto finalize(const ray &r, const hit_query &q, hit_record &rec) const -> void override;
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override;
+  [[nodiscard]] auto bounding_box() const -> aabb override {
+    return bbox;
+  }
+  [[nodiscard]] auto pdf_value(const point3 &origin, const vec3d &v) const -> double override;
+  [[nodiscard]] auto random(const point3 &origin) const -> vec3d override;
+  auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
+    os << prefix << "[Mesh]: vertices = " << std::max(positions.size(), positions_f.size())
+       << " triangles = " << indices.size() << " nodes = " << nodes.size()
+       << (single ? " float" : "") << (mapped != nullptr ? " (cached)" : "");
+  }
+  friend auto operator<<(std::ostream &os, const triangle_mesh &m) -> std::ostream & {
+    m.print(os);
+    return os;
+  }
+
+private:
+  std::unique_ptr<mesh_buffers> owned; // 从 OBJ 建出来的数据
+  std::unique_ptr<mapped_file> mapped; // 或者映射进来的缓存
+
+  auto load(const obj_data &obj, double scale) -> void;
+  auto build(bvh_split split) -> void;
+  // span 指向 owned 中的数组
+  auto view_owned() -> void;
+  static auto cache_file(const std::string &dir, const std::string &filename, double scale,
+      bvh_split split, bool single) -> std::string;
+  auto load_cache(const std::string &path, uint64_t source_hash, uint64_t source_size,
+      double scale, bvh_split split) -> bool;
+  [[nodiscard]] auto save_cache(const std::string &path, uint64_t source_hash,
+      uint64_t source_size, double scale, bvh_split split) const -> bool;
+  /**
+   * @brief Möller Trumbore 求交，只算 t 和重心坐标
+   */
+  [[nodiscard]] inline auto intersect(uint32_t tri, const ray &r, interval ray_t, double &t,
+      double &b1, double &b2) const -> bool;
+  /**
+   * @brief 单精度的保守测试：只排除考虑舍入误差后仍不可能相交的三角形
+   */
+  [[nodiscard]] inline auto may_intersect(uint32_t tri, const vec3f &orig, const vec3f &dir,
+      float orig_size, interval ray_t) const -> bool;
+};
+
+auto triangle_mesh::load(const obj_data &obj, double scale) -> void {
+  // 面的角按 (顶点, 纹理, 法线) 下标合并成网格顶点；不做 smooth 时法线不参与合并也不保存，
+  // smooth 但 OBJ 没有给出法线的角用面法线，这样的角不与其它面共享
+  auto &b = *owned;
+  std::unordered_map<mesh_vertex_key, uint32_t, mesh_vertex_hash> unique;
+  // 最常见的情况（只有顶点）直接按顶点下标映射
+  bool by_position = !smooth && obj.texcoords.empty();
+  std::vector<uint32_t> remap(by_position ? obj.positions.size() : 0, obj_no_index);
+  b.indices.reserve(obj.faces.size());
+  for (uint32_t f = 0; f < obj.faces.size(); ++f) {
+    const auto &face = obj.faces[f];
+    std::array<uint32_t, 3> tri{};
+    for (int k = 0; k < 3; ++k) {
+      const auto &c = face[k];
+      uint32_t id = 0;
+      if (by_position) {
+        if (remap[c.v] == obj_no_index)
+          remap[c.v] = b.positions.size();
+        id = remap[c.v];
+      } else {
+        bool face_normal = smooth && c.vn == obj_no_index;
+        mesh_vertex_key key = {c.v, c.vt, smooth ? c.vn : obj_no_index,
+            face_normal ? f : obj_no_index};
+        id = unique.try_emplace(key, b.positions.size()).first->second;
+      }
+      tri[k] = id;
+      if (id < b.positions.size())
+        continue;
+      const auto &pos = obj.positions[c.v];
+      b.positions.emplace_back(point3(pos[0], pos[1], pos[2]) * scale);
+      b.tu.push_back(c.vt != obj_no_index ? obj.texcoords[c.vt][0] : 0);
+      b.tv.push_back(c.vt != obj_no_index ? obj.texcoords[c.vt][1] : 0);
+      if (smooth) {
+        vec3d n;
+        if (c.vn != obj_no_index) {
+          n = vec3d(obj.normals[c.vn][0], obj.normals[c.vn][1], obj.normals[c.vn][2]);
+        } else {
+          auto p = [&](int i) {
+            const auto &q = obj.positions[face[i].v];
+            return point3(q[0], q[1], q[2]);
+          };
+          n = cross(p(1) - p(0), p(2) - p(0));
+        }
+        b.nx.push_back(n.x());
+        b.ny.push_back(n.y());
+        b.nz.push_back(n.z());
+      }
+    }
+    b.indices.push_back(tri);
+  }
+  // float 精度时先舍入顶点，BVH 和面积都按舍入后的顶点计算
+  if (single) {
+    b.positions_f.reserve(b.positions.size());
+    for (const auto &p : b.positions)
+      b.positions_f.emplace_back(p);
+    std::vector<point3>().swap(b.positions);
+  }
+  view_owned();
+}
+
+auto triangle_mesh::build(bvh_split split) -> void {
+  auto &b = *owned;
+  b.nodes.clear();
+  if (b.indices.empty())
+    return;
+  // 建树期间反复用到三角形的包围盒，先算好
+  std::vector<uint32_t> ids(b.indices.size());
+  std::vector<aabb> boxes(b.indices.size());
+  for (uint32_t i = 0; i < ids.size(); ++i) {
+    ids[i] = i;
+    boxes[i] = triangle_bounds(i);
+    bbox = aabb(bbox, boxes[i]);
+  }
+  build_linear_bvh(ids, boxes, 0, ids.size(), split, b.nodes);
+
+  // 三角形按叶子顺序重排，叶子的 prim_offset 即为 indices 中的位置
+  std::vector<std::array<uint32_t, 3>> ordered(b.indices.size());
+  for (size_t i = 0; i < ids.size(); ++i)
+    ordered[i] = b.indices[ids[i]];
+  b.indices.swap(ordered);
+
+  b.area_cdf.resize(b.indices.size());
+  double sum = 0;
+  for (size_t i = 0; i < b.indices.size(); ++i) {
+    auto v0 = vertex(b.indices[i][0]);
+    auto e1 = vertex(b.indices[i][1]) - v0;
+    auto e2 = vertex(b.indices[i][2]) - v0;
+    sum += 0.5 * cross(e1, e2).length();
+    b.area_cdf[i] = sum;
+  }
+  view_owned();
+}
+
+auto triangle_mesh::view_owned() -> void {
+  const auto &b = *owned;
+  positions = b.positions, positions_f = b.positions_f, tu = b.tu, tv = b.tv;
+  nx = b.nx, ny = b.ny, nz = b.nz;
+  indices = b.indices, nodes = b.nodes, area_cdf = b.area_cdf;
+}
+
+// 缓存放在 dir 下，不写进模型目录；文件名的哈希包含 OBJ 的绝对路径、缩放、划分方式和精度，
+// 不同目录下的同名 OBJ、同一个 OBJ 以不同参数使用时各有一份
+auto triangle_mesh::cache_file(const std::string &dir, const std::string &filename,
+    double scale, bvh_split split, bool single) -> std::string {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  auto source = fs::absolute(filename, ec).lexically_normal().string();
+  if (ec)
+    source = filename;
+  auto s = static_cast<uint32_t>(split) | (single ? 0x100 : 0);
+  auto h = content_hash(source.data(), source.size());
+  h = content_hash(&scale, sizeof(scale), h);
+  h = content_hash(&s, sizeof(s), h);
+  char buf[17];
+  std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+  auto name = fs::path(filename).filename().string() + "." + buf + ".rtcache";
+  return (fs::path(dir) / name).string();
+}
+
+namespace mesh_cache_detail {
+constexpr size_t align = 64;
+inline auto aligned(size_t n) -> size_t {
+  return (n + align - 1) / align * align;
+}
+// 各段的字节数，按文件中的顺序
+inline auto sections(const mesh_cache_header &h) -> std::array<size_t, 9> {
+  size_t v = h.vertex_count, t = h.triangle_count;
+  size_t n = h.smooth != 0 ? v : 0;
+  auto vertex_size = h.single != 0 ? sizeof(vec3f) : sizeof(point3);
+  return {v * vertex_size, v * sizeof(double), v * sizeof(double), n * sizeof(double),
+      n * sizeof(double), n * sizeof(double), t * sizeof(std::array<uint32_t, 3>),
+      h.node_count * sizeof(linear_bvh_node), t * sizeof(double)};
+}
+} // namespace mesh_cache_detail
+
+auto triangle_mesh::load_cache(const std::string &path, uint64_t source_hash,
+    uint64_t source_size, double scale, bvh_split split) -> bool {
+  using namespace mesh_cache_detail;
+  auto file = std::make_unique<mapped_file>(path);
+  if (!file->valid() || file->size() < sizeof(mesh_cache_header))
+    return false;
+  mesh_cache_header h;
+  std::memcpy(&h, file->data(), sizeof(h));
+  if (h.magic != mesh_cache_magic || h.version != mesh_cache_version ||
+      h.source_hash != source_hash || h.source_size != source_size || h.scale != scale ||
+      h.smooth != static_cast<uint32_t>(smooth) || h.split != static_cast<uint32_t>(split) ||
+      h.single != static_cast<uint32_t>(single))
+    return false;
+  auto sizes = sections(h);
+  size_t total = aligned(sizeof(h));
+  for (auto n : sizes)
+    total += aligned(n);
+  if (total != file->size()) {
+    std::cerr << "mesh cache " << path << " is truncated\n";
+    return false;
+  }
+  // 各段直接指向映射的内存，不做拷贝
+  const char *p = file->data() + aligned(sizeof(h));
+  auto next = [&](size_t i) {
+    const char *cur = p;
+    p += aligned(sizes[i]);
+    return cur;
+  };
+  size_t v = h.vertex_count, t = h.triangle_count, n = h.smooth != 0 ? v : 0;
+  if (single)
+    positions_f = {reinterpret_cast<const vec3f *>(next(0)), v};
+  else
+    positions = {reinterpret_cast<const point3 *>(next(0)), v};
+  tu = {reinterpret_cast<const double *>(next(1)), v};
+  tv = {reinterpret_cast<const double *>(next(2)), v};
+  nx = {reinterpret_cast<const double *>(next(3)), n};
+  ny = {reinterpret_cast<const double *>(next(4)), n};
+  nz = {reinterpret_cast<const double *>(next(5)), n};
+  indices = {reinterpret_cast<const std::array<uint32_t, 3> *>(next(6)), t};
+  nodes = {reinterpret_cast<const linear_bvh_node *>(next(7)), h.node_count};
+  area_cdf = {reinterpret_cast<const double *>(next(8)), t};
+  bbox = aabb(point3(h.bbox[0], h.bbox[1], h.bbox[2]), point3(h.bbox[3], h.bbox[4], h.bbox[5]));
+  mapped = std::move(file);
+  return true;
+}
+
+// 与断点文件一样先写临时文件再改名，并发的两次渲染不会读到写了一半的缓存；
+// 临时文件名带上进程号和序号，同时写同一份缓存的进程或线程互不覆盖
+auto triangle_mesh::save_cache(const std::string &path, uint64_t source_hash,
+    uint64_t source_size, double scale, bvh_split split) const -> bool {
+  using namespace mesh_cache_detail;
+  mesh_cache_header h;
+  h.source_hash = source_hash, h.source_size = source_size, h.scale = scale;
+  h.smooth = smooth, h.split = static_cast<uint32_t>(split), h.single = single;
+  h.vertex_count = single ? positions_f.size() : positions.size();
+  h.triangle_count = indices.size();
+  h.node_count = nodes.size();
+  h.bbox = {bbox.x().min, bbox.y().min, bbox.z().min, bbox.x().max, bbox.y().max, bbox.z().max};
+  std::error_code ec;
+  std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+  static std::atomic<uint32_t> counter{0};
+  auto tmp = path + "." + std::to_string(::getpid()) + "." + std::to_string(counter++) + ".tmp";
+  std::ofstream out(tmp, std::ios::binary);
+  if (!out)
+    return false;
+  static const char zeros[align] = {};
+  auto write = [&](const void *data, size_t n) {
+    out.write(static_cast<const char *>(data), n);
+    out.write(zeros, aligned(n) - n);
+  };
+  write(&h, sizeof(h));
+  if (single)
+    write(positions_f.data(), positions_f.size_bytes());
+  else
+    write(positions.data(), positions.size_bytes());
+  write(tu.data(), tu.size_bytes());
+  write(tv.data(), tv.size_bytes());
+  write(nx.data(), nx.size_bytes());
+  write(ny.data(), ny.size_bytes());
+  write(nz.data(), nz.size_bytes());
+  write(indices.data(), indices.size_bytes());
+  write(nodes.data(), nodes.size_bytes());
+  write(area_cdf.data(), area_cdf.size_bytes());
+  out.close();
+  if (!out)
+    return false;
+  return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+inline auto triangle_mesh::intersect(uint32_t tri, const ray &r, interval ray_t, double &t,
+    double &b1, double &b2) const -> bool {
+  const auto &id = indices[tri];
+  auto v0 = vertex(id[0]);
+  auto e1 = vertex(id[1]) - v0;
+  auto e2 = vertex(id[2]) - v0;
+  auto s = r.origin() - v0;
+  auto s1 = cross(r.direction(), e2);
+  auto s2 = cross(s, e1);
+  auto D = dot(s1, e1);
+  if (std::abs(D) < esp)
+    return false;
+  D = 1 / D;
+  t = dot(s2, e2) * D;
+  b1 = dot(s1, s) * D;
+  b2 = dot(s2, r.direction()) * D;
+  return !(t < ray_t.min || t > ray_t.max || b1 < esp || b2 < esp || 1 - b1 - b2 < esp);
+}
+
+inline auto triangle_mesh::may_intersect(uint32_t tri, const vec3f &orig, const vec3f &dir,
+    float orig_size, interval ray_t) const -> bool {
+  const auto &id = indices[tri];
+  auto v0 = positions_f[id[0]];
+  auto e1 = positions_f[id[1]] - v0;
+  auto e2 = positions_f[id[2]] - v0;
+  auto s = orig - v0;
+  auto s1 = cross(dir, e2);
+  auto s2 = cross(s, e1);
+  // 不做除法：b1 = u / D, b2 = v / D, t = w / D，先统一成 D > 0
+  float D = dot(s1, e1), u = dot(s1, s), v = dot(s2, dir), w = dot(s2, e2);
+  if (D < 0)
+    D = -D, u = -u, v = -v, w = -w;
+  // 舍入误差的上界：参与运算的向量的 L1 范数之积乘以若干倍机器精度，
+  // 起点舍入到 float 的误差算在 |s| 里；NaN 的比较为 false，不会被排除
+  float ls = s.abs_sum3() + orig_size, le = e1.abs_sum3() + e2.abs_sum3();
+  float bound = 16 * FLT_EPSILON * dir.abs_sum3() * (ls + le) * le;
+  double t_bound = 16 * FLT_EPSILON * double(ls + le) * le * le;
+  if (u < -bound || v < -bound || u + v > D + 2 * bound)
+    return false;
+  return !(w < ray_t.min * (D + bound) - t_bound - ray_t.min * 2 * bound ||
+           w > ray_t.max * (D + bound) + t_bound);
+}
+
+// 遍历时只记录最近的三角形与重心坐标，法线和纹理坐标由 finalize() 最后只算一次
+auto triangle_mesh::probe(const ray &r, interval ray_t, hit_query &q) const -> bool {
+  if (nodes.empty())
+    return false;
+  vec3f orig(r.origin()), dir(r.direction());
+  float orig_size = orig.abs_sum3();
+  uint32_t closest = 0;
+  double t = 0, b1 = 0, b2 = 0;
+  bool hit_anything = traverse_flat_bvh(nodes.data(), r, ray_t,
+      [&](uint32_t offset, uint32_t count, interval &t_range) -> bool {
+        bool hit_leaf = false;
+        for (uint32_t i = offset; i < offset + count; ++i) {
+          double ti, u, v;
+          if (single && !may_intersect(i, orig, dir, orig_size, t_range))
+            continue;
+          if (intersect(i, r, t_range, ti, u, v)) {
+            hit_leaf = true;
+            t_range.max = ti;
+            closest = i, t = ti, b1 = u, b2 = v;
+          }
+        }
+        return hit_leaf;
+      });
+  if (!hit_anything)
+    return false;
+  q.index = closest, q.t = t, q.b1 = b1, q.b2 = b2;
+  q.prim = this;
+  return true;
+}
+
+// 整包遍历网格的 BVH，叶子中逐条光线求交
+auto triangle_mesh::probe_packet(ray_packet &packet, packet_queries &q) const -> uint32_t {
+  if (nodes.empty())
+    return 0;
+  std::array<vec3f, packet_width> orig, dir;
+  std::array<float, packet_width> orig_size{};
+  if (single) {
+    for (uint32_t k = 0; k < packet_width; ++k) {
+      orig[k] = vec3f(packet.rays[k].origin()), dir[k] = vec3f(packet.rays[k].direction());
+      orig_size[k] = orig[k].abs_sum3();
+    }
+  }
+  bvh_packet bp(packet);
+  uint32_t hits = 0;
+  traverse_flat_bvh_packet(nodes.data(), bp,
+      [&](uint32_t offset, uint32_t count, uint32_t mask) {
+        for (; mask != 0; mask &= mask - 1) {
+          auto k = std::countr_zero(mask);
+          const auto &r = packet.rays[k];
+          auto &t_range = packet.ray_t[k];
+          bool hit_leaf = false;
+          for (uint32_t i = offset; i < offset + count; ++i) {
+            double ti, u, v;
+            if (single && !may_intersect(i, orig[k], dir[k], orig_size[k], t_range))
+              continue;
+            if (intersect(i, r, t_range, ti, u, v)) {
+              hit_leaf = true;
+              t_range.max = ti;
+              q[k].index = i, q[k].t = ti, q[k].b1 = u, q[k].b2 = v;
+            }
+          }
+          if (hit_leaf) {
+            hits |= 1u << k;
+            q[k].prim = this;
+            bp.shrink(k, t_range.max);
+          }
+        }
+      });
+  return hits;
+}
+
+auto triangle_mesh::finalize(const ray &r, const hit_query &q, hit_record &rec) const -> void {
+  const auto &id = indices[q.index];
+  auto v0 = vertex(id[0]);
+  auto face_normal = unit_vector(cross(vertex(id[1]) - v0, vertex(id[2]) - v0));
+  double b1 = q.b1, b2 = q.b2, b0 = 1 - b1 - b2;
+  rec.t = q.t;
+  rec.p = r.at(q.t);
+  if (smooth) {
+    auto n = b0 * vec3d(nx[id[0]], ny[id[0]], nz[id[0]]) +
+             b1 * vec3d(nx[id[1]], ny[id[1]], nz[id[1]]) +
+             b2 * vec3d(nx[id[2]], ny[id[2]], nz[id[2]]);
+    // 插值法线与面法线同侧，保证 front_face 判断一致
+    n = unit_vector(n);
+    rec.front_face = dot(r.direction(), face_normal) < 0;
+    rec.normal = rec.front_face == (dot(n, face_normal) > 0) ? n : -n;
+  } else {
+    rec.set_face_normal(r, face_normal);
+  }
+  rec.u = b0 * tu[id[0]] + b1 * tu[id[1]] + b2 * tu[id[2]];
+  rec.v = b0 * tv[id[0]] + b1 * tv[id[1]] + b2 * tv[id[2]];
+  rec.mat_ptr = mat_ptr;
+}
+
+auto triangle_mesh::occluded(const ray &r, interval ray_t) const -> bool {
+  if (nodes.empty())
+    return false;
+  vec3f orig(r.origin()), dir(r.direction());
+  float orig_size = orig.abs_sum3();
+  return traverse_flat_bvh<true>(nodes.data(), r, ray_t,
+      [&](uint32_t offset, uint32_t count, interval &t_range) -> bool {
+        double t, u, v;
+        for (uint32_t i = offset; i < offset + count; ++i) {
+          if (single && !may_intersect(i, orig, dir, orig_size, t_range))
+            continue;
+          if (intersect(i, r, t_range, t, u, v))
+            return true;
+        }
+        return false;
+      });
+}
+
+// 作为光源时按面积均匀采样整个网格
+[[nodiscard]] auto triangle_mesh::pdf_value(const point3 &origin, const vec3d &v) const
+    -> double {
+  hit_record rec;
+  if (area_cdf.empty() || !this->hit(ray(origin, v), interval(0.001, infinity), rec))
+    return 0;
+  auto distance_squared = rec.t * rec.t * v.length_squared();
+  auto cosine = fabs(dot(v, rec.normal) / v.length());
+  return distance_squared / (cosine * area_cdf.back());
+}
+
+[[nodiscard]] auto triangle_mesh::random(const point3 &origin) const -> vec3d {
+  if (area_cdf.empty())
+    return {1, 0, 0};
+  auto target = sample_1d() * area_cdf.back();
+  auto tri = std::min<size_t>(
+      std::lower_bound(area_cdf.begin(), area_cdf.end(), target) - area_cdf.begin(),
+      indices.size() - 1);
+  const auto &id = indices[tri];
+  auto [u, v] = sample_2d();
+  if (u + v > 1)
+    u = 1 - u, v = 1 - v;
+  auto v0 = vertex(id[0]);
+  auto p = v0 + u * (vertex(id[1]) - v0) + v * (vertex(id[2]) - v0);
+  return p - origin;
+}
+
+
+/**
+ * @class mesh_ref
+ * @brief 网格的一次摆放：多个 mesh_ref 共享同一个 triangle_mesh（底层 BVH），各自只保存材质
+ *
+ * 同一个 OBJ 摆放多次时三角形和 BVH 只有一份，摆放的位置由外层的 instance 决定
+ */
+class mesh_ref : public hittable {
+public:
+  std::shared_ptr<const triangle_mesh> mesh;
+  material *mat_ptr = nullptr;
+
+public:
+  mesh_ref(std::shared_ptr<const triangle_mesh> m, material *mat)
+      : mesh(std::move(m)), mat_ptr(mat) {}
+
+  auto hit(const ray &r, interval ray_t, hit_record &rec) const -> bool override {
+    return hit_deferred(*this, r, ray_t, rec);
+  }
+  // 交点由共享的网格计算，最后换成自己的材质
+  auto probe(const ray &r, interval ray_t, hit_query &q) const -> bool override {
+    if (!mesh->probe(r, ray_t, q))
+      return false;
+    q.prim = this;
+    return true;
+  }
+  auto probe_packet(ray_packet &packet, packet_queries &q) const -> uint32_t override {
+    auto hits = mesh->probe_packet(packet, q);
+    for (uint32_t k = 0; k < packet_width; ++k) {
+      if (hits >> k & 1)
+        q[k].prim = this;
+    }
+    return hits;
+  }
+  auto finalize(const ray &r, const hit_query &q, hit_record &rec) const -> void override {
+    mesh->finalize(r, q, rec);
+    rec.mat_ptr = mat_ptr;
+  }
+  [[nodiscard]] auto occluded(const ray &r, interval ray_t) const -> bool override {
+    return mesh->occluded(r, ray_t);
+  }
+  [[nodiscard]] auto bounding_box() const -> aabb override {
+    return mesh->bounding_box();
+  }
+  [[nodiscard]] auto pdf_value(const point3 &origin, const vec3d &v) const -> double override {
+    return mesh->pdf_value(origin, v);
+  }
+  [[nodiscard]] auto random(const point3 &origin) const -> vec3d override {
+    return mesh->random(origin);
+  }
+  auto print(std::ostream &os, const std::string &prefix = "") const -> void override {
+    os << prefix << "[MeshRef] use_count = " << mesh.use_count() << " ";
+    mesh->print(os);
+  }
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstdint>
@@ -33,34 +34,112 @@ inline auto degrees_to_radians(double degrees) -> double {
 }
 
 /**
- * @brief 随机数生成 double(0.0, 1.0)
+ * @class pcg32
+ * @brief PCG32 随机数引擎（64 位状态，32 位输出），seq 选择互不相交的序列
+ */
+class pcg32 {
+public:
+  uint64_t state = 0x853c49e6748fea9bULL;
+  uint64_t inc = 0xda3e39cb94b95bdbULL;
+
+public:
+  pcg32() = default;
+  pcg32(uint64_t init_state, uint64_t seq) {
+    seed(init_state, seq);
+  }
+  inline auto seed(uint64_t init_state, uint64_t seq) -> void {
+    state = 0;
+    inc = (seq << 1u) | 1u;
+    next_uint();
+    state += init_state;
+    next_uint();
+  }
+  inline auto next_uint() -> uint32_t {
+    uint64_t old = state;
+    state = old * 6364136223846793005ULL + inc;
+    auto xorshifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+    auto rot = static_cast<uint32_t>(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+  }
+  // [0, 1)
+  inline auto next_double() -> double {
+    return next_uint() * 0x1p-32;
+  }
+  // [0, bound)，拒绝采样去掉取模偏差
+  inline auto next_bounded(uint32_t bound) -> uint32_t {
+    uint32_t threshold = (-bound) % bound;
+    while (true) {
+      uint32_t r = next_uint();
+      if (r >= threshold)
+        return r % bound;
+    }
+  }
+};
+
+/**
+ * @brief 把 64 位整数打散（splitmix64 的终结步骤），用于由计数器生成种子
+ */
+inline auto mix_bits(uint64_t v) -> uint64_t {
+  v ^= v >> 31;
+  v *= 0x7fb5d329728ea185ULL;
+  v ^= v >> 27;
+  v *= 0x81dadef4bc2dd44dULL;
+  v ^= v >> 33;
+  return v;
+}
+
+/**
+ * @brief 全局随机种子，场景 JSON 中的 "seed"
+ */
+inline auto random_seed() -> uint64_t & {
+  static uint64_t seed = 0;
+  return seed;
+}
+
+/**
+ * @brief 线程私有的随机数引擎，第一次使用时按 (全局种子, 线程序号) 初始化
+ */
+inline auto thread_rng() -> pcg32 & {
+  static std::atomic<uint64_t> thread_counter{0};
+  thread_local pcg32 rng(mix_bits(random_seed()), thread_counter.fetch_add(1));
+  return rng;
+}
+
+/**
+ * @brief 设置全局种子，并重新初始化当前线程的引擎（之后新建的线程按新种子初始化）
+ */
+inline auto set_random_seed(uint64_t seed) -> void {
+  random_seed() = seed;
+  thread_rng().seed(mix_bits(seed), 0);
+}
+
+/**
+ * @brief 把当前线程的引擎切到 (像素, 采样序号) 对应的序列
+ * 同一像素的同一个采样总是得到相同的随机数，与线程调度无关
+ */
+inline auto seed_sample_stream(uint32_t x, uint32_t y, uint32_t sample) -> void {
+  uint64_t pixel = (uint64_t(y) << 32) | x;
+  thread_rng().seed(mix_bits(random_seed() ^ mix_bits(sample)), mix_bits(pixel));
+}
+
+/**
+ * @brief 随机数生成 double[0.0, 1.0)
  */
 inline auto random_double() -> double {
-  thread_local std::uniform_real_distribution<double> distribution(0.0, 1.0);
-  thread_local std::mt19937 generator{std::random_device{}()};
-  // thread_local std::mt19937 generator(10085);
-  return distribution(generator);
+  return thread_rng().next_double();
 }
 /**
- * @brief 随机数生成 double(min, max)
+ * @brief 随机数生成 double[min, max)
  */
 inline auto random_double(double min, double max) -> auto {
-  return [min, max]() -> double {
-    thread_local std::uniform_real_distribution<double> distribution(min, max);
-    thread_local std::mt19937 generator{std::random_device{}()};
-    // thread_local std::mt19937 generator(10085);
-    return distribution(generator);
-  };
+  return [min, max]() -> double { return min + (max - min) * random_double(); };
 }
 /**
- * @brief 随机数生成 Int(min, max)
+ * @brief 随机数生成 Int[min, max]
  */
 inline auto random_int(int min, int max) -> auto {
   return [min, max]() -> int {
-    thread_local std::uniform_int_distribution<> distribution(min, max);
-    thread_local std::mt19937 generator{std::random_device{}()};
-    // thread_local std::mt19937 generator(10085);
-    return distribution(generator);
+    return min + static_cast<int>(thread_rng().next_bounded(uint32_t(max - min) + 1));
   };
 }
 /**
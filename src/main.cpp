@@ -6,15 +6,24 @@
 auto main(int argc, const char **argv) -> int {
   scene Scene;
 
-  // 命令行读入参数为生成的图片命名
+  // 命令行：RayTracing [scene.json] [--resume]
   std::string json_file = "examples/main.json";
-  if (argc >= 2) {
-    json_file = std::string(argv[1]);
-    std::cout << "Reading : " << json_file << "\n";
+  bool resume = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--resume") {
+      resume = true;
+    } else {
+      json_file = arg;
+      std::cout << "Reading : " << json_file << "\n";
+    }
   }
   if (!Scene.scene_parse(json_file)) {
     std::cerr << "can not parse json_file " << json_file << "\n";
+    return 1;
   }
+  if (!Scene.set_resume(resume))
+    return 1;
   Scene.generate();
 
   return 0;
@@ -15,7 +15,7 @@ public:
   auto scatter(const ray &r_in, const hit_record &rec, scatter_record &srec) const
       -> bool override {
     srec.attenuation = color(1.0, 1.0, 1.0);
-    srec.pdf_ptr = nullptr;
+    srec.pdf_storage = std::monostate{};
     srec.skip_pdf = true;
     double refraction_ratio = rec.front_face ? (1.0 / ir) : ir;
 
@@ -26,7 +26,7 @@ public:
     bool cannot_refract = refraction_ratio * sin_theta > 1.0;
     vec3d direction;
 
-    if (cannot_refract || reflectance(cos_theta, refraction_ratio) > random_double())
+    if (cannot_refract || reflectance(cos_theta, refraction_ratio) > sample_1d())
       direction = reflect(unit_direction, rec.normal);
     else
       direction = refract(unit_direction, rec.normal, refraction_ratio);
@@ -27,7 +27,7 @@ public:
   auto scatter([[maybe_unused]] const ray &r_in, const hit_record &rec,
       scatter_record &srec) const -> bool override {
     srec.attenuation = albedo->value(rec.u, rec.v, rec.p);
-    srec.pdf_ptr = std::make_shared<cosine_pdf>(rec.normal);
+    srec.pdf_storage.emplace<cosine_pdf>(rec.normal);
     srec.skip_pdf = false;
     return true;
   }
@@ -18,9 +18,21 @@ struct hit_record;
 class scatter_record {
 public:
   color attenuation;
-  std::shared_ptr<pdf> pdf_ptr;
+  scatter_pdf pdf_storage; // 内联存放的 pdf
   bool skip_pdf;
   ray skip_pdf_ray;
+
+  // 当前 pdf 的基类指针，skip_pdf 时为 nullptr
+  [[nodiscard]] auto pdf_ptr() const -> const pdf * {
+    return std::visit(
+        [](const auto &p) -> const pdf * {
+          if constexpr (std::is_base_of_v<pdf, std::decay_t<decltype(p)>>)
+            return &p;
+          else
+            return nullptr;
+        },
+        pdf_storage);
+  }
 };
 
 /**
@@ -23,7 +23,7 @@ public:
   auto scatter(const ray &r_in, const hit_record &rec, scatter_record &srec) const
       -> bool override {
     srec.attenuation = albedo;
-    srec.pdf_ptr = nullptr;
+    srec.pdf_storage = std::monostate{};
     srec.skip_pdf = true;
     vec3d reflected = reflect(unit_vector(r_in.direction()), rec.normal);
     srec.skip_pdf_ray = ray(rec.p, reflected + fuzz * random_in_unit_sphere());
@@ -2,6 +2,7 @@
 #define PDF_HPP
 
 #include <utility>
+#include <variant>
 
 #include "../vector/vec3dx4.h"
 #include "../geometry/ONB.hpp"
@@ -49,27 +50,20 @@ public:
   onb uvw;
 };
 
+// 只引用两个 pdf，不拥有它们：两者都在调用方的栈上（或 scatter_record 内），生命周期覆盖本次弹射
 class mixture_pdf : public pdf {
 public:
-  std::array<std::shared_ptr<pdf>, 2> p;
+  std::array<const pdf *, 2> p;
 
 public:
-  mixture_pdf(std::shared_ptr<pdf> &p0, std::shared_ptr<pdf> &p1) {
-    p[0] = p0;
-    p[1] = p1;
-  }
-  // ~mixture_pdf() override {
-  //   for (auto &i : p) {
-  //     delete i;
-  //   }
-  // }
+  mixture_pdf(const pdf &p0, const pdf &p1) : p{&p0, &p1} {}
 
   [[nodiscard]] auto value(const vec3d &direction) const -> double override {
     return 0.5 * p[0]->value(direction) + 0.5 * p[1]->value(direction);
   }
 
   [[nodiscard]] auto generate() const -> vec3d override {
-    if (random_double() < 0.5)
+    if (sample_1d() < 0.5)
       return p[0]->generate();
     else
       return p[1]->generate();
@@ -94,4 +88,10 @@ public:
   }
 };
 
+/**
+ * @brief 材质散射时用到的 pdf 直接存放在 scatter_record 里，每次弹射不再分配堆内存
+ * monostate 表示不使用 pdf（skip_pdf）
+ */
+using scatter_pdf = std::variant<std::monostate, cosine_pdf, sphere_pdf>;
+
 #endif
\ No newline at end of file
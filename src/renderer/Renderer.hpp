@@ -7,7 +7,33 @@
 #include "../camera/camerabase.hpp"
 #include "../geometry/hittablelist.hpp"
 #include "../material/material.hpp"
+#include "film.hpp"
+#include "tile_scheduler.hpp"
+#include "wavefront.hpp"
+#include <chrono>
 #include <memory>
+#include <optional>
+#include <sstream>
+
+/**
+ * @brief 积分器
+ * Recursive : 递归，每次弹射都走到 max_depth（有光源时混合光源采样，否则余弦采样）
+ * Path      : 迭代路径追踪，累乘 throughput，rr_depth 之后俄罗斯轮盘赌终止
+ * NEE       : 在 Path 的基础上，每个非镜面交点向光源连一条阴影射线，与 BSDF 采样做 MIS
+ */
+enum class integrator_type {
+  Recursive,
+  Path,
+  NEE,
+};
+
+/**
+ * @brief MIS 的幂启发式权重（beta = 2）
+ */
+inline auto power_heuristic(double pdf_f, double pdf_g) -> double {
+  auto f = pdf_f * pdf_f, g = pdf_g * pdf_g;
+  return f + g > 0 ? f / (f + g) : 0;
+}
 
 template <class Camera>
 class Renderer {
@@ -20,14 +46,33 @@ public:
   double aspect_ratio = 16.0 / 9.0;
   uint32_t image_width = 1200;
   uint32_t image_height = static_cast<uint32_t>(image_width / aspect_ratio);
-  uint32_t samples_per_pixel = 64;   // 单素采样数
-  uint32_t max_depth = 10;           // 光线递归深度
-  uint32_t async_num = 36;           // 线程数
-  color background = color(0, 0, 0); // 背景辐射
-  bool no_light;
+  uint32_t samples_per_pixel = 64;            // 单素采样数
+  uint32_t max_depth = 10;                    // 光线递归深度
+  uint32_t rr_depth = 3;                      // 从第几次弹射开始轮盘赌
+  uint32_t async_num = resolve_thread_num(0); // 线程数（默认为硬件线程数）
+  uint32_t tile_size = 16;                    // 分块边长
+  double adaptive_threshold = 0;              // 自适应采样的相对误差阈值，0 为关闭
+  uint32_t min_spp = 16;                      // 自适应采样：每个像素至少的采样数
+  uint32_t max_spp = 0;                       // 自适应采样：每个像素最多的采样数（0 为 8 * pps）
+  uint32_t pass_spp = 0;                      // 渐进式渲染每轮的采样数，0 为关闭
+  double snapshot_interval = 0;               // 渐进式渲染写出快照的间隔（秒），0 为每轮
+  double checkpoint_interval = 0;             // 写断点的间隔（秒），0 为不写
+  double time_budget = 0;                     // 限时渲染的时间（秒），0 为按 pps 渲染
+  std::string checkpoint_path;                // 断点文件，默认为图片名 + ".ckpt"
+  uint64_t scene_hash = 0;                    // 场景与影响采样结果的设置的哈希，写入断点
+  bool resume = false;                        // 从断点继续渲染
+  film frame;                                 // 累积缓冲
+  color background = color(0, 0, 0);          // 背景辐射
+  bool no_light = true;
+  bool packet_tracing = true;                 // 相机光线按光线包求第一个交点
+  bool wavefront = false;                     // 按批分阶段追踪（只用于 Path / NEE）
   using RayColorFuncPtr = color (Renderer<Camera>::*)(
-      const ray &, const hittable &, const hittable &, int);
+      const ray &, const hittable &, const hittable &, int, const std::optional<hit_record> *);
   RayColorFuncPtr rayColorFuncPtr = &Renderer<Camera>::ray_color_cos;
+  // 积分器的一次弹射，wavefront 引擎的着色阶段调用；Recursive 积分器没有
+  using ShadeFuncPtr = void (Renderer<Camera>::*)(
+      path_state &, bool, const hit_record &, const hittable &, const hittable &, int);
+  ShadeFuncPtr shadeFuncPtr = nullptr;
 
 public:
   Renderer() = default;
@@ -35,8 +80,8 @@ public:
   Renderer(hittable_list &hitlist, hittable_list &lightlist, double ratio, uint32_t width)
       : world(hitlist), light(lightlist), aspect_ratio(ratio), image_width(width) {
     image_height = static_cast<uint32_t>(image_width / aspect_ratio);
-    if (lightlist.objects.empty()) {
-      no_light = true;
+    no_light = lightlist.objects.empty();
+    if (no_light) {
       rayColorFuncPtr = &Renderer<Camera>::ray_color_cos;
     } else {
       rayColorFuncPtr = &Renderer<Camera>::ray_color;
@@ -47,64 +92,495 @@ public:
   auto set_photo_name(std::string name) { photoname = std::move(name); }
   auto set_samples_per_pixel(uint32_t samples) { samples_per_pixel = samples; }
   auto set_max_depth(uint32_t depth) { max_depth = depth; }
-  auto set_async_num(uint32_t num) { async_num = num; }
+  auto set_rr_depth(uint32_t depth) { rr_depth = depth; }
+  auto set_async_num(uint32_t num) { async_num = resolve_thread_num(num); }
+  auto set_tile_size(uint32_t size) { tile_size = std::max(1u, size); }
+  auto set_progressive(uint32_t spp, double interval) {
+    pass_spp = spp, snapshot_interval = interval;
+  }
+  auto set_checkpoint(double interval, std::string path) {
+    checkpoint_interval = interval, checkpoint_path = std::move(path);
+  }
+  auto set_resume(bool flag) { resume = flag; }
+  auto set_scene_hash(uint64_t hash) { scene_hash = hash; }
+  auto set_time_budget(double seconds) { time_budget = seconds; }
+  auto set_adaptive(double threshold, uint32_t min_s, uint32_t max_s) {
+    adaptive_threshold = threshold, min_spp = std::max(2u, min_s), max_spp = max_s;
+  }
   auto set_background(const color &c) { background = c;}
   auto set_no_light(bool flag) { no_light = flag;}
+  auto set_packet_tracing(bool flag) { packet_tracing = flag; }
+  auto set_wavefront(bool flag) { wavefront = flag; }
   // clang-format on
+  auto set_integrator(integrator_type type) {
+    // 没有光源时 NEE 无从采样，退化为 Path
+    shadeFuncPtr = nullptr;
+    if (type == integrator_type::Path || (type == integrator_type::NEE && no_light)) {
+      rayColorFuncPtr = &Renderer<Camera>::ray_color_path;
+      shadeFuncPtr = &Renderer<Camera>::shade_path;
+    } else if (type == integrator_type::NEE) {
+      rayColorFuncPtr = &Renderer<Camera>::ray_color_nee;
+      shadeFuncPtr = &Renderer<Camera>::shade_nee;
+    } else if (no_light) {
+      rayColorFuncPtr = &Renderer<Camera>::ray_color_cos;
+    } else {
+      rayColorFuncPtr = &Renderer<Camera>::ray_color;
+    }
+  }
   auto render() {
     bmp::bitmap photo(image_width, image_height); // photo
-    std::vector<std::future<void>> deque;         // thread deque
-    std::mutex cout_mutex;                        // lock the cnt and std::cout
+    frame = film(image_width, image_height);
+    if (wavefront && shadeFuncPtr == nullptr) {
+      std::cerr << "wavefront needs the Path or NEE integrator, tracing per sample\n";
+      wavefront = false;
+    }
+    // 光线包在各条光线生成之后才一起求交，求交要抽随机数（如体积）时只能逐条追踪
+    if (!world.deterministic_probe())
+      packet_tracing = false;
+    // 自适应采样与渐进式渲染、限时、断点互斥，scene::check_settings 已经拒绝了这些组合
+    if (adaptive_threshold > 0) {
+      render_adaptive();
+    } else if (pass_spp > 0 || checkpoint_interval > 0 || resume || time_budget > 0) {
+      render_progressive();
+    } else {
+      render_pass([&](uint32_t i, uint32_t j) { sample_pixel(i, j, samples_per_pixel); });
+    }
+    // 图像生成 set_RGB
+    frame.develop(photo);
+    write_image(photo);
+    if (time_budget > 0 || adaptive_threshold > 0)
+      write_spp_map();
+    // 自己写的 bmp 输出
+    // photo.generate(photoname);
+  }
+  auto write_image(const bmp::bitmap &photo) -> void {
+    stbi_flip_vertically_on_write(true);
+    auto data =
+        stbi_write_bmp(photoname.c_str(), image_width, image_height, 3, photo.image.data());
+    if (!data) {
+      std::cerr << "ERROR: Could not load texture image file '" << photoname << "'.\n";
+    }
+  }
+  /**
+   * @brief 每个像素最终的采样数写到 image_name + ".spp.pgm"（16 位灰度，值即采样数），
+   *        并输出统计信息
+   */
+  auto write_spp_map() const -> void {
+    auto path = photoname + ".spp.pgm";
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+      std::cerr << "can not write " << path << "\n";
+      return;
+    }
+    out << "P5\n" << image_width << " " << image_height << "\n65535\n";
+    uint32_t lo = std::numeric_limits<uint32_t>::max(), hi = 0;
+    for (uint32_t j = image_height; j-- > 0;) {
+      for (uint32_t i = 0; i < image_width; ++i) {
+        auto spp = frame.at(i, j).spp;
+        lo = std::min(lo, spp), hi = std::max(hi, spp);
+        auto v = static_cast<uint16_t>(std::min(spp, 65535u));
+        std::array<char, 2> be = {char(v >> 8), char(v & 0xff)};
+        out.write(be.data(), 2);
+      }
+    }
+    // 在局部的流里设置格式，不改动 std::cout 的状态
+    std::ostringstream avg;
+    avg << std::fixed << std::setprecision(2)
+        << double(frame.total_samples()) / frame.pixels.size();
+    std::cout << "[spp] min = " << lo << " max = " << hi << " avg = " << avg.str()
+              << " map = " << path << "\n";
+  }
+  [[nodiscard]] auto checkpoint_file() const -> std::string {
+    return checkpoint_path.empty() ? photoname + ".ckpt" : checkpoint_path;
+  }
+  /**
+   * @brief 断点要校验的内容：种子、场景哈希和目标采样数
+   */
+  [[nodiscard]] auto checkpoint_key(uint32_t target) const -> film_checkpoint_header {
+    film_checkpoint_header key;
+    key.seed = random_seed(), key.scene_hash = scene_hash, key.target_spp = target;
+    return key;
+  }
+  /**
+   * @brief 渐进式渲染：每轮给所有像素加 pass_spp 个采样，轮与轮之间把当前结果写到图片，
+   *        并按 checkpoint_interval 写断点。写文件在后台线程进行，下一轮的渲染不用等待磁盘
+   *
+   * 第 k 个采样只由 (种子, 像素, k) 决定，且每个像素按采样序号依次累加，
+   * 所以从断点继续得到的结果与一次渲染完全相同
+   */
+  auto render_progressive() {
+    using clock = std::chrono::steady_clock;
+    // 限时模式下 pps 不再是目标，只受 max_pps 限制（0 为不限）
+    bool timed = time_budget > 0;
+    auto target = timed ? (max_spp != 0 ? max_spp : std::numeric_limits<uint32_t>::max())
+                        : samples_per_pixel;
+    auto key = checkpoint_key(target);
+    if (resume) {
+      if (frame.load(checkpoint_file(), key))
+        std::cout << "[resume] " << checkpoint_file() << " spp = " << frame.min_spp() << "\n";
+      else
+        std::cerr << "can not resume from " << checkpoint_file() << ", start from scratch\n";
+    }
+    auto step = pass_spp > 0 ? pass_spp : (timed ? 4u : std::min(samples_per_pixel, 16u));
+    auto start = clock::now();
+    auto deadline = start + std::chrono::duration_cast<clock::duration>(
+                                std::chrono::duration<double>(time_budget));
+    auto done = std::min(frame.min_spp(), target);
+    auto passes = (uint64_t(target) - done + step - 1) / step;
+    auto last_snapshot = clock::now(), last_checkpoint = clock::now();
+    auto seconds_since = [](clock::time_point t) {
+      return std::chrono::duration<double>(clock::now() - t).count();
+    };
+    std::future<void> writer, checkpoint_writer;
+    auto busy = [](const std::future<void> &f) {
+      return f.valid() && f.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+    };
+    for (uint64_t pass = 0; pass < passes; ++pass) {
+      // 限时模式下到点后各线程不再给已有采样的像素加采样，最后一轮可能只覆盖了部分像素，
+      // 每个像素按自己的采样数求平均。还没有采样的像素不受时限约束，
+      // 所以第一轮总会完整跑完，时间太短时会超出预算，但不会留下黑色像素
+      render_pass(
+          [&](uint32_t i, uint32_t j) {
+            auto have = frame.at(i, j).spp;
+            if (timed && have > 0 && clock::now() >= deadline)
+              return;
+            if (have < target)
+              sample_pixel(i, j, std::min(step, target - have));
+          },
+          false);
+      if (timed) {
+        std::ostringstream elapsed;
+        elapsed << std::fixed << std::setprecision(1) << seconds_since(start);
+        std::cout << "\r[time budget] pass " << pass + 1 << " " << elapsed.str() << " / "
+                  << time_budget << " s" << std::flush;
+        if (clock::now() >= deadline)
+          break;
+      } else {
+        std::cout << "\r[progressive] pass " << pass + 1 << " / " << passes << std::flush;
+      }
+      if (pass + 1 == passes)
+        break;
+      // 上一次的文件还没写完时跳过这一轮，不阻塞渲染
+      if (checkpoint_interval > 0 && seconds_since(last_checkpoint) >= checkpoint_interval &&
+          !busy(checkpoint_writer)) {
+        checkpoint_writer = std::async(std::launch::async,
+            [path = checkpoint_file(), copy = frame, key] {
+              if (!copy.save(path, key))
+                std::cerr << "can not write checkpoint " << path << "\n";
+            });
+        last_checkpoint = clock::now();
+      }
+      if (pass_spp > 0 && seconds_since(last_snapshot) >= snapshot_interval && !busy(writer)) {
+        bmp::bitmap snapshot(image_width, image_height);
+        frame.develop(snapshot);
+        writer = std::async(std::launch::async,
+            [this, snapshot = std::move(snapshot)] { write_image(snapshot); });
+        last_snapshot = clock::now();
+      }
+    }
+    if (writer.valid())
+      writer.wait();
+    if (checkpoint_writer.valid())
+      checkpoint_writer.wait();
+    // 完成后写最终的断点，之后可以用更大的 pps 继续渲染
+    if (checkpoint_interval > 0 && !frame.save(checkpoint_file(), key))
+      std::cerr << "can not write checkpoint " << checkpoint_file() << "\n";
+    std::cout << "\n";
+  }
+  /**
+   * @brief 多线程遍历整张图，对每个像素调用 func(i, j)
+   */
+  template <class PixelFunc>
+  auto render_pass(PixelFunc &&func, bool show_progress = true) {
+    std::vector<std::future<void>> workers; // thread pool
+    std::mutex cout_mutex;                  // lock the cnt and std::cout
     std::int32_t cnt = 0;
+    /*
+      线程任务划分：图像切成 tile_size * tile_size 的小块，每个线程一个队列，
+      做完自己的块后去偷别的线程的，避免玻璃球、烟雾所在的区域拖慢整体
+    */
+    tile_scheduler scheduler(image_width, image_height, tile_size, async_num);
     // 开始渲染和显示进度
-    UpdateProgress(cnt, image_height - 1);
-    // 各像素片渲染函数，
-
-    // auto possionsamples = possionSamplesInit(true);
-    auto action = [&](uint32_t jl, uint32_t jr) -> void {
-      for (uint32_t j = jl; j < jr; ++j) {
-        for (uint32_t i = 0; i < image_width; ++i) {
-          color pixel_color = simple_random_sampling(i, j);
-          // color pixel_color = sqrt_random_sampling(i, j);
-          // color pixel_color = poissonSamples(i, j, possionsamples);
-          photo.set_RGB(i, j, pixel_color, samples_per_pixel);
+    if (show_progress)
+      UpdateProgress(cnt, scheduler.total);
+
+    auto action = [&](uint32_t id) -> void {
+      tile t{};
+      while (scheduler.pop(id, t)) {
+        for (uint32_t j = t.y0; j < t.y1; ++j) {
+          for (uint32_t i = t.x0; i < t.x1; ++i) {
+            func(i, j);
+          }
         }
+        // wavefront 和光线包模式下 func 只登记采样，整块一起追踪
+        if (wavefront)
+          trace_wavefront(sample_queue());
+        else if (packet_tracing)
+          trace_packets(sample_queue());
+        if (!show_progress)
+          continue;
         cout_mutex.lock();
-        UpdateProgress(++cnt, image_height - 1);
+        UpdateProgress(++cnt, scheduler.total);
         cout_mutex.unlock();
       }
     };
-    /*
-      线程任务划分：图像高度 / 线程数，计算完任务片后将线程启用并塞入队列
-    */
-    uint32_t block = image_height / async_num;
-    uint32_t superfluous = image_height - block * async_num;
-    for (uint32_t ti = 0, k = 0; ti != async_num; ++ti) {
-      uint32_t jl = ti * block + k, jr = (ti + 1) * block + k;
-      if (k < superfluous) {
-        jr++, k++;
-      }
-      deque.emplace_back(std::async(std::launch::async, action, jl, jr));
-    }
+    for (uint32_t id = 0; id != async_num; ++id)
+      workers.emplace_back(std::async(std::launch::async, action, id));
     // 等待各个线程都完成
-    for (auto &i : deque) {
-      // 逐渐输出图片
-      // stbi_flip_vertically_on_write(true);
-      // auto data = stbi_write_bmp(photoname.c_str(), image_width, image_height, 3,
-      // photo.image.data()); if (!data) {
-      //   std::cerr << "ERROR: Could not load texture image file '" << photoname << "'.\n";
-      // }
+    for (auto &i : workers) {
       i.wait();
     }
-    // 图像生成 set_RGB
-    stbi_flip_vertically_on_write(true);
-    auto data =
-        stbi_write_bmp(photoname.c_str(), image_width, image_height, 3, photo.image.data());
-    if (!data) {
-      std::cerr << "ERROR: Could not load texture image file '" << photoname << "'.\n";
+  }
+  /**
+   * @brief 自适应采样：先给每个像素 min_spp 个采样，之后每轮给相对误差超过阈值的块
+   *        中的像素再加 min_spp 个，直到全部收敛、达到 max_spp 或用完 pps * 像素数
+   *        的总预算。预算不够分时只给误差最大的那些块
+   */
+  auto render_adaptive() {
+    uint64_t budget = uint64_t(samples_per_pixel) * image_width * image_height;
+    uint32_t limit = max_spp != 0 ? max_spp : samples_per_pixel * 8;
+    uint32_t batch = std::min(min_spp, limit);
+    render_pass([&](uint32_t i, uint32_t j) { sample_pixel(i, j, batch); });
+    uint64_t used = uint64_t(batch) * image_width * image_height;
+
+    // 按 tile_size 划分统计误差的块
+    uint32_t bw = (image_width + tile_size - 1) / tile_size;
+    uint32_t bh = (image_height + tile_size - 1) / tile_size;
+    std::vector<uint32_t> block_spp(size_t(bw) * bh, batch);
+    std::vector<uint8_t> active(block_spp.size());
+    std::vector<std::pair<double, uint32_t>> candidates;
+    while (used < budget) {
+      candidates.clear();
+      for (uint32_t b = 0; b < block_spp.size(); ++b) {
+        uint32_t x0 = b % bw * tile_size, y0 = b / bw * tile_size;
+        auto err = frame.block_error(x0, y0, std::min(x0 + tile_size, image_width),
+            std::min(y0 + tile_size, image_height));
+        if (err > adaptive_threshold && block_spp[b] < limit)
+          candidates.emplace_back(err, b);
+      }
+      if (candidates.empty())
+        break;
+      // 预算按整块的像素数估计
+      auto keep = std::min<uint64_t>(
+          candidates.size(), (budget - used) / (uint64_t(batch) * tile_size * tile_size));
+      if (keep == 0)
+        break;
+      if (keep < candidates.size()) {
+        std::nth_element(candidates.begin(), candidates.begin() + keep, candidates.end(),
+            [](const auto &a, const auto &b) { return a.first > b.first; });
+        candidates.resize(keep);
+      }
+      std::fill(active.begin(), active.end(), 0);
+      for (auto [err, b] : candidates)
+        active[b] = 1;
+      std::cout << "\n[adaptive] blocks = " << candidates.size() << " samples = " << used
+                << " / " << budget << "\n";
+      // 每块各自追加 batch 个采样，接近 max_pps 的块只补到上限，不拖小其他块的步长
+      auto step = [&](uint32_t b) { return std::min(batch, limit - block_spp[b]); };
+      render_pass([&](uint32_t i, uint32_t j) {
+        auto b = j / tile_size * bw + i / tile_size;
+        if (active[b])
+          sample_pixel(i, j, step(b));
+      });
+      for (auto [err, b] : candidates)
+        block_spp[b] += step(b);
+      used = frame.total_samples();
     }
-    // 自己写的 bmp 输出
-    // photo.generate(photoname);
+    std::cout << "\n[adaptive] samples = " << frame.total_samples() << " / " << budget << "\n";
+  }
+  /**
+   * @brief 给像素 (i, j) 追加 count 个采样，第 k 个采样总是使用序号 k 的随机序列
+   */
+  auto sample_pixel(uint32_t i, uint32_t j, uint32_t count) {
+    auto s = frame.at(i, j).spp, end = s + count;
+    if (wavefront || packet_tracing) {
+      sample_queue().push_back({i, j, s, count});
+      return;
+    }
+    for (; s < end; ++s) {
+      ray r = camera_ray(i, j, s);
+      frame.add_sample(i, j, (this->*rayColorFuncPtr)(r, world, light, max_depth, nullptr));
+    }
+  }
+  /**
+   * @brief 像素 (i, j) 第 s 个采样的相机光线：像素内位置和光圈位置取自采样器的前 4 维
+   */
+  auto camera_ray(uint32_t i, uint32_t j, uint32_t s) -> ray {
+    start_pixel_sample(i, j, s);
+    auto [dx, dy] = sample_2d();
+    return cam.get_ray((i + dx) / (image_width - 1), (j + dy) / (image_height - 1));
+  }
+  /**
+   * @brief 光线包引擎：块内每 2 * 2 个像素为一组，组内的像素轮流取下一个采样填入包中，
+   *        满 packet_width 条就追踪一次，1 spp 时一个包就是一组像素的同一个采样序号
+   *
+   * 边角不满 2 * 2 的组和采样数不同的像素由后面的采样补满，最后不满的包用 active 屏蔽空位；
+   * 每个像素的采样仍按序号从小到大累加
+   */
+  auto trace_packets(std::vector<sample_request> &requests) -> void {
+    auto group = [](const sample_request &r) { return std::pair(r.y / 2, r.x / 2); };
+    // 稳定排序：同一组的像素相邻，组内保持行优先的顺序
+    std::stable_sort(requests.begin(), requests.end(),
+        [&](const auto &a, const auto &b) { return group(a) < group(b); });
+    std::array<sample_request, packet_width> lanes; // 每条光线的像素和采样序号（first）
+    uint32_t n = 0;
+    for (size_t g = 0, e = 0; g < requests.size(); g = e) {
+      while (e < requests.size() && group(requests[e]) == group(requests[g]))
+        ++e;
+      for (bool more = true; more;) {
+        more = false;
+        for (auto k = g; k < e; ++k) {
+          auto &req = requests[k];
+          if (req.count == 0)
+            continue;
+          lanes[n++] = {req.x, req.y, req.first++, 1};
+          more = --req.count > 0 || more;
+          if (n == packet_width)
+            sample_packet(lanes, std::exchange(n, 0));
+        }
+      }
+    }
+    if (n > 0)
+      sample_packet(lanes, n);
+    requests.clear();
+  }
+  /**
+   * @brief 追踪 lanes 的前 n 个采样：相机光线打成一个包，一起遍历 BVH 求第一个交点，
+   *        之后逐条光线着色（第一次弹射之后走标量路径）
+   *
+   * 每条光线生成后保存随机数状态和采样游标，着色前恢复，结果与逐条追踪相同
+   * （前提是求交不抽随机数，render() 在 world.deterministic_probe() 为 false 时关闭光线包）
+   */
+  auto sample_packet(const std::array<sample_request, packet_width> &lanes, uint32_t n) {
+    ray_packet packet;
+    std::array<sample_stream, packet_width> states;
+    for (uint32_t k = 0; k < n; ++k) {
+      packet.rays[k] = camera_ray(lanes[k].x, lanes[k].y, lanes[k].first);
+      packet.ray_t[k] = interval(0.001, infinity);
+      states[k] = sample_stream::save();
+    }
+    packet.active = (1u << n) - 1;
+    std::array<hit_record, packet_width> recs;
+    auto hits = hit_packet(world, packet, recs);
+    for (uint32_t k = 0; k < n; ++k) {
+      states[k].restore();
+      std::optional<hit_record> primary;
+      if (hits >> k & 1)
+        primary = recs[k];
+      frame.add_sample(lanes[k].x, lanes[k].y,
+          (this->*rayColorFuncPtr)(packet.rays[k], world, light, max_depth, &primary));
+    }
+  }
+  // 每个线程登记的待追踪采样（wavefront 和光线包模式）
+  static auto sample_queue() -> std::vector<sample_request> & {
+    thread_local std::vector<sample_request> queue;
+    return queue;
+  }
+  /**
+   * @brief wavefront 引擎：把登记的采样分成不超过 wavefront_batch 条路径的批，
+   *        每批生成相机光线后按阶段推进，全部结束后按像素、采样序号的顺序累加
+   */
+  auto trace_wavefront(std::vector<sample_request> &requests) -> void {
+    thread_local std::vector<wavefront_path> paths;
+    size_t next = 0;
+    while (next < requests.size()) {
+      paths.clear();
+      // 生成：相机光线，每条路径保存生成之后的随机数状态和采样游标
+      while (next < requests.size() && paths.size() < wavefront_batch) {
+        auto &req = requests[next];
+        auto take = std::min<uint32_t>(req.count, wavefront_batch - paths.size());
+        for (uint32_t s = req.first; s < req.first + take; ++s) {
+          auto &p = paths.emplace_back();
+          p.state.cur = camera_ray(req.x, req.y, s);
+          p.state.alive = max_depth > 0;
+          p.stream = sample_stream::save();
+          p.x = req.x, p.y = req.y;
+        }
+        req.first += take, req.count -= take;
+        if (req.count == 0)
+          ++next;
+      }
+      advance_wavefront(paths);
+      for (const auto &p : paths)
+        frame.add_sample(p.x, p.y, p.state.radiance);
+    }
+    requests.clear();
+  }
+  /**
+   * @brief 推进一批路径直到全部结束，每一轮：
+   *        按方向和起点排序 -> 求交 -> 按材质排序 -> 着色 -> 存活的路径排队进入下一轮
+   */
+  auto advance_wavefront(std::vector<wavefront_path> &paths) -> void {
+    std::vector<uint32_t> queue;
+    for (uint32_t k = 0; k < paths.size(); ++k) {
+      if (paths[k].state.alive)
+        queue.push_back(k);
+    }
+    thread_local wavefront_sorter sorter;
+    auto bounds = world.bounding_box();
+    // 同一批的路径同步推进，第一轮都是相机光线
+    for (bool primary = true; !queue.empty(); primary = false) {
+      // 方向相近、起点相近的光线相邻，遍历的结点相近；相机光线还打成光线包一起求交
+      sorter.by_ray(queue, paths, bounds);
+      intersect_wavefront(paths, queue, primary && packet_tracing);
+      // 同一材质的 scatter 和纹理查询连续执行
+      sorter.by_material(queue, paths);
+      for (auto k : queue) {
+        auto &p = paths[k];
+        p.stream.restore();
+        (this->*shadeFuncPtr)(p.state, p.hit, p.rec, world, light, max_depth);
+        p.stream = sample_stream::save();
+      }
+      std::erase_if(queue, [&](uint32_t k) { return !paths[k].state.alive; });
+    }
+  }
+  /**
+   * @brief 求交阶段：packet 为 true 时排序后相邻的 packet_width 条光线打成一个包
+   *
+   * 逐条求交时先恢复路径自己的随机数状态，求交抽的数（如体积）与逐条追踪相同，
+   * 之后的着色接着使用；光线包只在 world.deterministic_probe() 为 true 时打开
+   */
+  auto intersect_wavefront(std::vector<wavefront_path> &paths,
+      const std::vector<uint32_t> &queue, bool packet) -> void {
+    if (!packet) {
+      for (auto k : queue) {
+        auto &p = paths[k];
+        p.stream.restore();
+        p.hit = world.hit(p.state.cur, interval(0.001, infinity), p.rec);
+        p.stream = sample_stream::save();
+      }
+      return;
+    }
+    std::array<hit_record, packet_width> recs;
+    for (size_t n = 0; n < queue.size(); n += packet_width) {
+      ray_packet packet;
+      auto lanes = std::min<size_t>(packet_width, queue.size() - n);
+      for (size_t k = 0; k < lanes; ++k) {
+        packet.rays[k] = paths[queue[n + k]].state.cur;
+        packet.ray_t[k] = interval(0.001, infinity);
+      }
+      packet.active = (1u << lanes) - 1;
+      auto hits = hit_packet(world, packet, recs);
+      for (size_t k = 0; k < lanes; ++k) {
+        auto &p = paths[queue[n + k]];
+        p.hit = hits >> k & 1;
+        if (p.hit)
+          p.rec = recs[k];
+      }
+    }
+  }
+  /**
+   * @brief 求 r 的最近交点；primary 非空时直接使用光线包求出的结果
+   *        （std::nullopt 表示没有击中）
+   */
+  auto first_hit(const ray &r, const hittable &world, hit_record &rec,
+      const std::optional<hit_record> *primary) -> bool {
+    if (primary == nullptr)
+      return world.hit(r, interval(0.001, infinity), rec);
+    if (!primary->has_value())
+      return false;
+    rec = **primary;
+    return true;
   }
   auto render_single() {
     bmp::bitmap photo(image_width, image_height); // photo
@@ -128,22 +604,22 @@ public:
   auto simple_random_sampling(uint32_t i, uint32_t j) -> color {
     color res(0, 0, 0);
     for (uint32_t s = 0; s < samples_per_pixel; ++s) {
-      auto u = (i + random_double()) / (image_width - 1);
-      auto v = (j + random_double()) / (image_height - 1);
-      ray r = cam.get_ray(u, v);
-      res += (this->*rayColorFuncPtr)(r, world, light, max_depth);
+      ray r = camera_ray(i, j, s);
+      res += (this->*rayColorFuncPtr)(r, world, light, max_depth, nullptr);
       // res += ray_color(r, world, light, max_depth);
     }
     return res;
   }
   auto sqrt_random_sampling(uint32_t i, uint32_t j) -> color {
-    std::cout << "[ " << i << ", " << j << " ]\n";
     thread_local uint32_t N = std::sqrt(samples_per_pixel);
     color res(0, 0, 0);
     for (uint32_t di = 0; di < N; ++di) {
       for (uint32_t dj = 0; dj < N; ++dj) {
-        auto u = (i + (di + random_double()) / N) / (image_width - 1);
-        auto v = (j + (dj + random_double()) / N) / (image_height - 1);
+        // 格子内的抖动取自采样器的前两维
+        start_pixel_sample(i, j, di * N + dj);
+        auto [du, dv] = sample_2d();
+        auto u = (i + (di + du) / N) / (image_width - 1);
+        auto v = (j + (dj + dv) / N) / (image_height - 1);
         ray r = cam.get_ray(u, v);
 
         res += ray_color(r, world, light, max_depth);
@@ -169,23 +645,26 @@ public:
   }
   auto poissonSamples(uint32_t i, uint32_t j, std::vector<std::pair<double, double>> &samples) -> color {
     color res(0, 0, 0);
+    uint32_t s = 0;
     for (auto p : samples) {
+      start_pixel_sample(i, j, s++);
       auto u = (i + p.first) / (image_width - 1);
       auto v = (j + p.second) / (image_height - 1);
       ray r = cam.get_ray(u, v);
-      res += (this->*rayColorFuncPtr)(r, world, light, max_depth);
+      res += (this->*rayColorFuncPtr)(r, world, light, max_depth, nullptr);
     }
     return res;
   }
-  // 发射光线返回得到颜色
-  auto ray_color(const ray &r, const hittable &world, const hittable &lights, int depth)
-      -> color {
+  // 发射光线返回得到颜色，primary 为光线包已经求出的第一个交点
+  auto ray_color(const ray &r, const hittable &world, const hittable &lights, int depth,
+      const std::optional<hit_record> *primary = nullptr) -> color {
     // 递归次数限制
     if (depth <= 0)
       return {0, 0, 0};
+    start_bounce(static_cast<int>(max_depth) - depth);
     hit_record rec;
     // 如果光线什么都没有击中，则返回背景颜色
-    if (!world.hit(r, interval(0.001, infinity), rec))
+    if (!first_hit(r, world, rec, primary))
       return background;
 
     scatter_record srec;
@@ -196,9 +675,9 @@ public:
     if (srec.skip_pdf) {
       return srec.attenuation * ray_color(srec.skip_pdf_ray, world, lights, depth - 1);
     }
-    std::shared_ptr<pdf> light_ptr = std::make_shared<hittable_pdf>(lights, rec.p);
+    hittable_pdf light_pdf(lights, rec.p);
     // 混合 pdf 采样
-    mixture_pdf p(light_ptr, srec.pdf_ptr);
+    mixture_pdf p(light_pdf, *srec.pdf_ptr());
     ray scattered = ray(rec.p, p.generate());
     auto pdf_val = p.value(scattered.direction());
 
@@ -209,13 +688,14 @@ public:
 
     return color_from_emission + color_from_scatter;
   }
-  auto ray_color_cos(const ray &r, const hittable &world, const hittable &lights, int depth)
-      -> color {
+  auto ray_color_cos(const ray &r, const hittable &world, const hittable &lights, int depth,
+      const std::optional<hit_record> *primary = nullptr) -> color {
     if (depth <= 0)
       return {0, 0, 0};
+    start_bounce(static_cast<int>(max_depth) - depth);
     hit_record rec;
 
-    if (!world.hit(r, interval(0.001, infinity), rec))
+    if (!first_hit(r, world, rec, primary))
       return background;
 
     scatter_record srec;
@@ -236,11 +716,172 @@ public:
 
     return color_from_emission + color_from_scatter;
   }
+  /**
+   * @brief 迭代路径追踪：throughput 记录路径到目前为止的衰减，rr_depth 次弹射后
+   *        以 throughput 的最大分量为存活概率做俄罗斯轮盘赌，存活时除以该概率保持无偏
+   */
+  auto ray_color_path(const ray &r, const hittable &world, const hittable &lights, int depth,
+      const std::optional<hit_record> *primary = nullptr) -> color {
+    path_state s;
+    s.cur = r;
+    while (s.alive && s.bounce < depth) {
+      hit_record rec;
+      bool hit = first_hit(s.cur, world, rec, s.bounce == 0 ? primary : nullptr);
+      shade_path(s, hit, rec, world, lights, depth);
+    }
+    return s.radiance;
+  }
+  /**
+   * @brief Path 积分器的一次弹射：hit / rec 为 s.cur 的求交结果，更新 s 并生成下一条光线
+   */
+  auto shade_path(path_state &s, bool hit, const hit_record &rec,
+      [[maybe_unused]] const hittable &world, const hittable &lights, int depth) -> void {
+    start_bounce(s.bounce);
+    if (!hit) {
+      s.radiance += s.throughput * background;
+      s.alive = false;
+      return;
+    }
+    scatter_record srec;
+    s.radiance += s.throughput * rec.mat_ptr->emitted(s.cur, rec, rec.u, rec.v, rec.p);
+    if (!rec.mat_ptr->scatter(s.cur, rec, srec)) {
+      s.alive = false;
+      return;
+    }
+    if (srec.skip_pdf) {
+      s.throughput = s.throughput * srec.attenuation;
+      s.cur = srec.skip_pdf_ray;
+    } else {
+      ray scattered;
+      double pdf_val;
+      if (no_light) {
+        cosine_pdf p(rec.normal);
+        scattered = ray(rec.p, p.generate());
+        pdf_val = p.value(scattered.direction());
+      } else {
+        hittable_pdf light_pdf(lights, rec.p);
+        mixture_pdf p(light_pdf, *srec.pdf_ptr());
+        scattered = ray(rec.p, p.generate());
+        pdf_val = p.value(scattered.direction());
+      }
+      if (!(pdf_val > 0)) {
+        s.alive = false;
+        return;
+      }
+      double scattering_pdf = rec.mat_ptr->scattering_pdf(s.cur, rec, scattered);
+      s.throughput = s.throughput * srec.attenuation * (scattering_pdf / pdf_val);
+      s.cur = scattered;
+    }
+    roulette(s, depth);
+  }
+  /**
+   * @brief 一次弹射结束：rr_depth 之后俄罗斯轮盘赌，到达 depth 时结束路径
+   */
+  auto roulette(path_state &s, int depth) -> void {
+    if (s.bounce + 1 >= static_cast<int>(rr_depth)) {
+      auto survive =
+          std::min(0.95, std::max({s.throughput[0], s.throughput[1], s.throughput[2]}));
+      if (sample_1d() >= survive) {
+        s.alive = false;
+        return;
+      }
+      s.throughput = s.throughput / survive;
+    }
+    if (++s.bounce >= depth)
+      s.alive = false;
+  }
+  /**
+   * @brief 对光源采样一个方向并连阴影射线，返回按 MIS 加权后的直接光照（未乘 throughput）
+   */
+  auto sample_light(const ray &r_in, const hit_record &rec, const pdf &bsdf,
+      const hittable &world, const hittable &lights) -> color {
+    ray shadow(rec.p, lights.random(rec.p));
+    hit_record lrec;
+    if (!lights.hit(shadow, interval(0.001, infinity), lrec) || lrec.mat_ptr == nullptr)
+      return {0, 0, 0};
+    auto Le = lrec.mat_ptr->emitted(shadow, lrec, lrec.u, lrec.v, lrec.p);
+    if (Le.near_zero())
+      return {0, 0, 0};
+    auto light_pdf = lights.pdf_value(rec.p, shadow.direction());
+    double scattering_pdf = rec.mat_ptr->scattering_pdf(r_in, rec, shadow);
+    if (!(light_pdf > 0) || !(scattering_pdf > 0))
+      return {0, 0, 0};
+    // 光源自身也在 world 中，阴影射线在到达光源前结束
+    if (world.occluded(shadow, interval(0.001, lrec.t * (1 - 1e-6))))
+      return {0, 0, 0};
+    auto w = power_heuristic(light_pdf, bsdf.value(shadow.direction()));
+    return Le * (scattering_pdf * w / light_pdf);
+  }
+  /**
+   * @brief 次事件估计：非镜面交点处对光源采样（阴影射线）+ 对 BSDF 采样，
+   *        两者用幂启发式 MIS 合并；BSDF 采样打到光源时按同样的权重计入自发光，
+   *        镜面弹射后（以及相机光线）打到的光源全额计入
+   */
+  auto ray_color_nee(const ray &r, const hittable &world, const hittable &lights, int depth,
+      const std::optional<hit_record> *primary = nullptr) -> color {
+    path_state s;
+    s.cur = r;
+    while (s.alive && s.bounce < depth) {
+      hit_record rec;
+      bool hit = first_hit(s.cur, world, rec, s.bounce == 0 ? primary : nullptr);
+      shade_nee(s, hit, rec, world, lights, depth);
+    }
+    return s.radiance;
+  }
+  /**
+   * @brief NEE 积分器的一次弹射，阴影射线在这里直接追踪
+   */
+  auto shade_nee(path_state &s, bool hit, const hit_record &rec, const hittable &world,
+      const hittable &lights, int depth) -> void {
+    start_bounce(s.bounce);
+    if (!hit) {
+      s.radiance += s.throughput * background;
+      s.alive = false;
+      return;
+    }
+    auto Le = rec.mat_ptr->emitted(s.cur, rec, rec.u, rec.v, rec.p);
+    if (!Le.near_zero()) {
+      auto w = 1.0;
+      if (!s.specular)
+        w = power_heuristic(s.bsdf_pdf, lights.pdf_value(s.prev_p, s.cur.direction()));
+      s.radiance += s.throughput * Le * w;
+    }
+    scatter_record srec;
+    if (!rec.mat_ptr->scatter(s.cur, rec, srec)) {
+      s.alive = false;
+      return;
+    }
+    if (srec.skip_pdf) {
+      s.throughput = s.throughput * srec.attenuation;
+      s.cur = srec.skip_pdf_ray;
+      s.specular = true;
+    } else {
+      const auto &bsdf = *srec.pdf_ptr();
+      // 阴影射线相当于多一次弹射，最后一次弹射不再连接，和 Path 的路径长度一致
+      if (s.bounce + 1 < depth)
+        s.radiance +=
+            s.throughput * srec.attenuation * sample_light(s.cur, rec, bsdf, world, lights);
+      ray scattered(rec.p, bsdf.generate());
+      s.bsdf_pdf = bsdf.value(scattered.direction());
+      if (!(s.bsdf_pdf > 0)) {
+        s.alive = false;
+        return;
+      }
+      double scattering_pdf = rec.mat_ptr->scattering_pdf(s.cur, rec, scattered);
+      s.throughput = s.throughput * srec.attenuation * (scattering_pdf / s.bsdf_pdf);
+      s.cur = scattered;
+      s.specular = false;
+      s.prev_p = rec.p;
+    }
+    roulette(s, depth);
+  }
   friend auto operator<<(std::ostream &os, const Renderer &r) -> std::ostream & {
     os << "[Renderer] : " << r.photoname << " [width] = " << r.image_width
        << " [height] = " << r.image_height << "\n";
-    os << "           | [async_num] = " << r.async_num << " [pps] = " << r.samples_per_pixel
-       << " [depth] = " << r.max_depth << "\n";
+    os << "           | [async_num] = " << r.async_num << " [tile] = " << r.tile_size
+       << " [pps] = " << r.samples_per_pixel << " [depth] = " << r.max_depth
+       << (r.rayColorFuncPtr == &Renderer<Camera>::ray_color_path ? " [path]" : "")
+       << (r.rayColorFuncPtr == &Renderer<Camera>::ray_color_nee ? " [nee]" : "") << "\n";
     if (r.light.objects.size() != 0 || r.background != color(0, 0, 0)) {
       os << "           | right source = true ";
     }
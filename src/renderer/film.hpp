@@ -0,0 +1,198 @@
+/**
+ * @file film.hpp
+ * @brief 胶片：逐像素累积采样结果与亮度的统计量
+ */
+#ifndef FILM_HPP
+#define FILM_HPP
+
+#include "../external/BMP.hpp"
+#include "../global.hpp"
+#include "../vector/vec3dx4.h"
+#include <cstdio>
+
+/**
+ * @brief 颜色的亮度（Rec.709）
+ */
+inline auto luminance(const color &c) -> double {
+  return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+}
+
+/**
+ * @class film_pixel
+ * @brief 一个像素的累积量：颜色和、亮度和、亮度平方和、采样数
+ */
+struct film_pixel {
+  color sum = color(0, 0, 0);
+  double lum_sum = 0;
+  double lum_sq_sum = 0;
+  uint32_t spp = 0;
+};
+
+constexpr uint32_t film_checkpoint_magic = 0x4b435452; // "RTCK"
+constexpr uint32_t film_checkpoint_version = 2;
+
+/**
+ * @class film_checkpoint_header
+ * @brief 断点文件头，像素数据紧随其后（每个像素 5 个 double + 1 个 uint32）
+ *
+ * 除了尺寸和种子，还记下场景的哈希（场景内容、max_depth、积分器、采样器等），
+ * 以及写断点时的目标采样数，设置改变后不能继续
+ */
+struct film_checkpoint_header {
+  uint32_t magic = film_checkpoint_magic;
+  uint32_t version = film_checkpoint_version;
+  uint32_t width = 0, height = 0;
+  uint64_t seed = 0;
+  uint64_t scene_hash = 0;
+  uint32_t target_spp = 0;
+  uint32_t reserved = 0;
+};
+
+/**
+ * @class film
+ * @brief 渲染目标，像素之间互不影响，同一时刻一个像素只由一个线程写入
+ */
+class film {
+public:
+  uint32_t width = 0, height = 0;
+  std::vector<film_pixel> pixels;
+
+public:
+  film() = default;
+  film(uint32_t w, uint32_t h) : width(w), height(h), pixels(size_t(w) * h) {}
+
+  auto at(uint32_t x, uint32_t y) -> film_pixel & {
+    return pixels[size_t(y) * width + x];
+  }
+  [[nodiscard]] auto at(uint32_t x, uint32_t y) const -> const film_pixel & {
+    return pixels[size_t(y) * width + x];
+  }
+  auto add_sample(uint32_t x, uint32_t y, const color &c) -> void {
+    auto &p = at(x, y);
+    auto lum = luminance(c);
+    p.sum += c;
+    p.lum_sum += lum;
+    p.lum_sq_sum += lum * lum;
+    p.spp++;
+  }
+  /**
+   * @brief 区域 [x0, x1) * [y0, y1) 的相对误差：各像素均值标准误差的均方根 / 区域平均亮度
+   *
+   * 单个像素在采样较少时方差估计很不可靠（例如 8 个采样都没打到光源，方差为 0），
+   * 按像素判断收敛会让这些像素提前停下而偏暗，所以按块统计
+   */
+  [[nodiscard]] auto block_error(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) const
+      -> double {
+    double sq_error = 0, lum = 0;
+    uint32_t count = 0;
+    for (uint32_t y = y0; y < y1; ++y) {
+      for (uint32_t x = x0; x < x1; ++x) {
+        const auto &p = at(x, y);
+        if (p.spp < 2)
+          return infinity;
+        double n = p.spp;
+        double mean = p.lum_sum / n;
+        double var = std::max(0.0, (p.lum_sq_sum - mean * p.lum_sum) / (n - 1));
+        // 显示时会截断到 1，确定超过 1 的像素再多采样也看不出差别
+        if (mean - 2 * std::sqrt(var / n) > 1)
+          continue;
+        sq_error += var / n;
+        lum += mean;
+        count++;
+      }
+    }
+    if (count == 0 || sq_error == 0)
+      return 0;
+    // 暗部的相对误差会被放大，给均值一个下限
+    return std::sqrt(sq_error / count) / std::max(lum / count, 0.1);
+  }
+  [[nodiscard]] auto total_samples() const -> uint64_t {
+    uint64_t total = 0;
+    for (const auto &p : pixels)
+      total += p.spp;
+    return total;
+  }
+  [[nodiscard]] auto min_spp() const -> uint32_t {
+    uint32_t res = std::numeric_limits<uint32_t>::max();
+    for (const auto &p : pixels)
+      res = std::min(res, p.spp);
+    return pixels.empty() ? 0 : res;
+  }
+  /**
+   * @brief 写断点文件：先写到临时文件再改名，写到一半被杀掉也不会破坏旧的断点
+   */
+  auto save(const std::string &path, film_checkpoint_header header) const -> bool {
+    auto tmp = path + ".tmp";
+    std::ofstream out(tmp, std::ios::binary);
+    if (!out)
+      return false;
+    header.width = width, header.height = height;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const auto &p : pixels) {
+      std::array<double, 5> data = {p.sum.x(), p.sum.y(), p.sum.z(), p.lum_sum, p.lum_sq_sum};
+      out.write(reinterpret_cast<const char *>(data.data()), sizeof(data));
+      out.write(reinterpret_cast<const char *>(&p.spp), sizeof(p.spp));
+    }
+    out.close();
+    if (!out)
+      return false;
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+  }
+  /**
+   * @brief 读断点文件，尺寸、种子或场景与当前渲染不一致时失败；
+   *        目标采样数只能变大（继续渲染），变小时也失败
+   */
+  auto load(const std::string &path, const film_checkpoint_header &expect) -> bool {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+      return false;
+    film_checkpoint_header header;
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!in || header.magic != film_checkpoint_magic ||
+        header.version != film_checkpoint_version) {
+      std::cerr << "checkpoint " << path << " is not a valid checkpoint\n";
+      return false;
+    }
+    if (header.width != width || header.height != height || header.seed != expect.seed) {
+      std::cerr << "checkpoint " << path << " does not match the scene (size or seed)\n";
+      return false;
+    }
+    if (header.scene_hash != expect.scene_hash) {
+      std::cerr << "checkpoint " << path << " was rendered with other scene settings\n";
+      return false;
+    }
+    if (header.target_spp > expect.target_spp) {
+      std::cerr << "checkpoint " << path << " was rendered with pps = " << header.target_spp
+                << ", larger than the current " << expect.target_spp << "\n";
+      return false;
+    }
+    std::vector<film_pixel> loaded(pixels.size());
+    for (auto &p : loaded) {
+      std::array<double, 5> data;
+      in.read(reinterpret_cast<char *>(data.data()), sizeof(data));
+      in.read(reinterpret_cast<char *>(&p.spp), sizeof(p.spp));
+      p.sum = color(data[0], data[1], data[2]);
+      p.lum_sum = data[3], p.lum_sq_sum = data[4];
+    }
+    if (!in) {
+      std::cerr << "checkpoint " << path << " is truncated\n";
+      return false;
+    }
+    pixels.swap(loaded);
+    return true;
+  }
+  /**
+   * @brief 按各像素自己的采样数求平均后写入位图
+   */
+  auto develop(bmp::bitmap &photo) const -> void {
+    for (uint32_t y = 0; y < height; ++y) {
+      for (uint32_t x = 0; x < width; ++x) {
+        const auto &p = at(x, y);
+        auto c = p.sum;
+        photo.set_RGB(x, y, c, std::max(1u, p.spp));
+      }
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * @file tile_scheduler.hpp
+ * @brief 分块 + 任务窃取的渲染调度
+ */
+#ifndef TILE_SCHEDULER_HPP
+#define TILE_SCHEDULER_HPP
+
+#include "../global.hpp"
+#include <deque>
+#include <mutex>
+#include <thread>
+
+/**
+ * @class tile
+ * @brief 图像上的一个矩形块 [x0, x1) * [y0, y1)
+ */
+struct tile {
+  uint32_t x0, y0, x1, y1;
+};
+
+/**
+ * @class tile_scheduler
+ * @brief 每个线程一个双端队列，自己从队头取，空闲时从别的线程队尾偷
+ *
+ * 初始时按扫描线顺序把连续的块分给各线程（保证局部性），
+ * 运行中不会再有新任务加入，所以所有队列都空时即可退出。
+ */
+class tile_scheduler {
+public:
+  std::vector<std::deque<tile>> queues;
+  std::vector<std::mutex> locks;
+  uint32_t total = 0;
+
+public:
+  tile_scheduler(uint32_t width, uint32_t height, uint32_t tile_size, uint32_t workers)
+      : queues(workers), locks(workers) {
+    std::vector<tile> tiles;
+    for (uint32_t y = 0; y < height; y += tile_size)
+      for (uint32_t x = 0; x < width; x += tile_size)
+        tiles.push_back(
+            {x, y, std::min(x + tile_size, width), std::min(y + tile_size, height)});
+    total = tiles.size();
+    // 连续分配：第 w 个线程拿 [w * n / workers, (w + 1) * n / workers)
+    for (uint32_t w = 0; w < workers; ++w) {
+      size_t l = size_t(w) * total / workers, r = size_t(w + 1) * total / workers;
+      queues[w].assign(tiles.begin() + l, tiles.begin() + r);
+    }
+  }
+  /**
+   * @brief 取一个块，自己的队列空了就去偷，全部为空时返回 false
+   */
+  auto pop(uint32_t worker, tile &t) -> bool {
+    {
+      std::lock_guard<std::mutex> guard(locks[worker]);
+      if (!queues[worker].empty()) {
+        t = queues[worker].front();
+        queues[worker].pop_front();
+        return true;
+      }
+    }
+    auto n = static_cast<uint32_t>(queues.size());
+    for (uint32_t k = 1; k < n; ++k) {
+      uint32_t victim = (worker + k) % n;
+      std::lock_guard<std::mutex> guard(locks[victim]);
+      if (!queues[victim].empty()) {
+        t = queues[victim].back();
+        queues[victim].pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+/**
+ * @brief 线程数为 0 时使用本机的硬件线程数
+ */
+inline auto resolve_thread_num(uint32_t num) -> uint32_t {
+  if (num != 0)
+    return num;
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * @file wavefront.hpp
+ * @brief wavefront 引擎的批量数据：路径状态、批中的路径、排序键
+ */
+#ifndef WAVEFRONT_HPP
+#define WAVEFRONT_HPP
+
+#include "../global.hpp"
+#include "../geometry/hittable.hpp"
+#include "../material/material.hpp"
+#include "../sampler/sampler.hpp"
+#include <numeric>
+#include <typeinfo>
+#include <unordered_map>
+
+constexpr uint32_t wavefront_batch = 1 << 10; // 一批最多同时追踪的路径数
+
+/**
+ * @class path_state
+ * @brief 一条路径在两次弹射之间的状态，Path / NEE 积分器与 wavefront 引擎共用
+ */
+struct path_state {
+  ray cur; // 下一条要追踪的光线
+  color radiance = color(0, 0, 0);
+  color throughput = color(1, 1, 1);
+  point3 prev_p;        // NEE：上一个交点
+  double bsdf_pdf = 0;  // NEE：上一次 BSDF 采样方向的概率密度
+  int bounce = 0;       // 已完成的弹射次数
+  bool specular = true; // NEE：上一次弹射是否为镜面（相机光线视为镜面）
+  bool alive = true;
+};
+
+/**
+ * @class sample_request
+ * @brief 一个像素要追加的采样：第 [first, first + count) 个（wavefront 和光线包按块收集）
+ */
+struct sample_request {
+  uint32_t x, y, first, count;
+};
+
+/**
+ * @class wavefront_path
+ * @brief 批中的一条路径：积分器状态、自己的随机数状态和采样游标、这一轮的求交结果
+ *
+ * 每条路径着色前换上自己的状态，所以结果与逐个采样追踪完全相同
+ */
+struct wavefront_path {
+  path_state state;
+  sample_stream stream;
+  hit_record rec;
+  uint32_t x = 0, y = 0;
+  bool hit = false;
+};
+
+constexpr uint32_t wavefront_grid_bits = 3; // 起点按 8 * 8 * 8 的格子分桶
+
+/**
+ * @brief 求交前的排序键（12 位）：方向所在的卦限在高位，起点在 bounds 中所在格子的
+ *        Morton 码在低位，方向相近、起点相近的光线排在一起
+ */
+inline auto ray_sort_key(const ray &r, const aabb &bounds) -> uint32_t {
+  constexpr uint32_t cells = 1 << wavefront_grid_bits;
+  auto o = r.origin(), d = r.direction();
+  uint32_t octant = (d[0] < 0) | (d[1] < 0) << 1 | (d[2] < 0) << 2;
+  std::array<uint32_t, 3> cell{};
+  for (int a = 0; a < 3; ++a) {
+    auto extent = bounds.axis[a].size();
+    auto x = extent > 0 && extent < infinity ? (o[a] - bounds.axis[a].min) / extent : 0.0;
+    cell[a] = std::min(cells - 1, static_cast<uint32_t>(std::clamp(x, 0.0, 1.0) * cells));
+  }
+  uint32_t morton = 0;
+  for (uint32_t b = 0; b < wavefront_grid_bits; ++b) {
+    for (uint32_t a = 0; a < 3; ++a)
+      morton |= (cell[a] >> b & 1) << (3 * b + a);
+  }
+  return octant << (3 * wavefront_grid_bits) | morton;
+}
+
+/**
+ * @class wavefront_sorter
+ * @brief 对路径下标做计数排序：键都是小整数，O(n + 桶数)，稳定
+ */
+class wavefront_sorter {
+public:
+  // 求交前按方向和起点排序
+  auto by_ray(std::vector<uint32_t> &queue, const std::vector<wavefront_path> &paths,
+      const aabb &bounds) -> void {
+    keys.resize(queue.size());
+    for (size_t n = 0; n < queue.size(); ++n)
+      keys[n] = ray_sort_key(paths[queue[n]].state.cur, bounds);
+    sort(queue, 1 << (3 + 3 * wavefront_grid_bits));
+  }
+  // 着色前排序：没击中的在前，其余按材质类型、再按材质对象排列
+  auto by_material(std::vector<uint32_t> &queue, const std::vector<wavefront_path> &paths)
+      -> void {
+    ids.clear(), materials.clear();
+    keys.resize(queue.size());
+    // 相邻的路径常常打到同一个材质，先和上一个比较，省去查表
+    const material *last = nullptr;
+    uint32_t last_id = 0;
+    for (size_t n = 0; n < queue.size(); ++n) {
+      const auto &p = paths[queue[n]];
+      const material *mat = p.hit ? p.rec.mat_ptr : nullptr;
+      if (n == 0 || mat != last) {
+        auto [it, fresh] = ids.try_emplace(mat, materials.size());
+        if (fresh)
+          materials.push_back(mat);
+        last = mat, last_id = it->second;
+      }
+      keys[n] = last_id;
+    }
+    // 编号按 (类型, 地址) 重排，同一类型的材质相邻
+    auto type_of = [](const material *m) { return m ? typeid(*m).hash_code() : 0; };
+    order.resize(materials.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      auto ta = type_of(materials[a]), tb = type_of(materials[b]);
+      return ta != tb ? ta < tb : std::less<const material *>()(materials[a], materials[b]);
+    });
+    rank.resize(order.size());
+    for (uint32_t r = 0; r < order.size(); ++r)
+      rank[order[r]] = r;
+    for (auto &k : keys)
+      k = rank[k];
+    sort(queue, materials.size());
+  }
+
+private:
+  std::vector<uint32_t> keys, counts, scratch, order, rank;
+  std::unordered_map<const material *, uint32_t> ids;
+  std::vector<const material *> materials;
+
+  auto sort(std::vector<uint32_t> &queue, uint32_t buckets) -> void {
+    counts.assign(buckets + 1, 0);
+    for (auto k : keys)
+      ++counts[k + 1];
+    for (uint32_t b = 1; b <= buckets; ++b)
+      counts[b] += counts[b - 1];
+    scratch.resize(queue.size());
+    for (size_t n = 0; n < queue.size(); ++n)
+      scratch[counts[keys[n]]++] = queue[n];
+    queue.swap(scratch);
+  }
+};
+
+#endif
@@ -0,0 +1,412 @@
+/**
+ * @file sampler.hpp
+ * @brief 采样器：按 (像素, 采样序号, 维度) 给出 [0, 1) 的样本，
+ *        像素内位置、光圈、光源选择、BSDF 方向、轮盘赌都从这里取数
+ */
+#ifndef SAMPLER_HPP
+#define SAMPLER_HPP
+
+#include "../global.hpp"
+
+/**
+ * @brief 采样器类型
+ * Random    : 独立随机数（pcg32），与以前的结果在统计上相同
+ * Sobol     : Owen 打乱的 Sobol (0, 2) 序列，维度按二维一组，每组按像素打乱下标
+ * Halton    : Owen 打乱的 Halton 序列，每一维一个质数底
+ * BlueNoise : 所有像素共用同一个 Sobol 序列，按蓝噪声贴图逐像素平移，误差呈蓝噪声分布
+ */
+enum class sampler_type {
+  Random,
+  Sobol,
+  Halton,
+  BlueNoise,
+};
+
+constexpr uint32_t camera_dims = 4; // 相机光线：像素内位置 2 维 + 光圈 2 维
+constexpr uint32_t bounce_dims = 8; // 每次弹射预留的维数，用完之后退回独立随机数
+
+/**
+ * @class sample_cursor
+ * @brief 当前线程正在生成的采样：像素 (x, y) 的第 index 个采样，下一个要取的维度 dim，
+ *        本次弹射可用的维度到 end 为止；seed 由全局种子和像素决定，每个采样开始时算一次
+ */
+struct sample_cursor {
+  uint32_t x = 0, y = 0, index = 0, dim = 0, end = camera_dims, seed = 0;
+};
+
+/**
+ * @class sampler
+ * @brief 采样器接口：c 为像素、采样序号与维度（c.dim 及之后）
+ */
+class sampler {
+public:
+  virtual ~sampler() = default;
+  [[nodiscard]] virtual auto get_1d(const sample_cursor &c) const -> double = 0;
+  [[nodiscard]] virtual auto get_2d(const sample_cursor &c) const -> std::array<double, 2> = 0;
+};
+
+namespace sampler_detail {
+
+inline auto reverse_bits(uint32_t x) -> uint32_t {
+  x = (x << 16) | (x >> 16);
+  x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+  x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+  x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+  x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+  return x;
+}
+// Owen 打乱（Burley 2020 的哈希实现）：位反转后做只向高位传播的置换，再反转回来
+inline auto owen_scramble(uint32_t x, uint32_t seed) -> uint32_t {
+  x = reverse_bits(x);
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return reverse_bits(x);
+}
+// Sobol 第 1 维按字节查表：sobol1_table[k][b] 为下标的第 k 个字节为 b 时异或上的方向数之和，
+// 方向数由 x + 1 递推：v_0 = 2^31，v_{i + 1} = v_i ^ (v_i >> 1)
+inline constexpr auto sobol1_table = [] {
+  std::array<std::array<uint32_t, 256>, 4> table{};
+  uint32_t v = 1u << 31;
+  for (uint32_t bit = 0; bit < 32; ++bit, v ^= v >> 1) {
+    for (uint32_t b = 0; b < 256; ++b) {
+      if (b >> (bit % 8) & 1)
+        table[bit / 8][b] ^= v;
+    }
+  }
+  return table;
+}();
+// Sobol 序列的前两维：第 0 维为以 2 为底的 van der Corput，第 1 维见 sobol1_table
+inline auto sobol(uint32_t index, uint32_t dim) -> uint32_t {
+  if (dim == 0)
+    return reverse_bits(index);
+  return sobol1_table[0][index & 0xff] ^ sobol1_table[1][index >> 8 & 0xff] ^
+         sobol1_table[2][index >> 16 & 0xff] ^ sobol1_table[3][index >> 24];
+}
+inline auto to_unit(uint32_t x) -> double {
+  return x * 0x1p-32;
+}
+// 32 位整数哈希（lowbias32）
+inline auto hash32(uint32_t x) -> uint32_t {
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+// 第 dim 维打乱用的种子
+inline auto dim_seed(uint32_t seed, uint32_t dim) -> uint32_t {
+  return hash32(seed ^ hash32(dim + 1));
+}
+// 与像素无关的种子（只由全局种子决定）
+inline auto scene_seed() -> uint32_t {
+  return static_cast<uint32_t>(mix_bits(random_seed() ^ 0x5bd1e995u));
+}
+
+} // namespace sampler_detail
+
+/**
+ * @class random_sampler
+ * @brief 独立随机数，直接取当前线程的 pcg32
+ */
+class random_sampler final : public sampler {
+public:
+  [[nodiscard]] auto get_1d([[maybe_unused]] const sample_cursor &c) const -> double override {
+    return random_double();
+  }
+  [[nodiscard]] auto get_2d([[maybe_unused]] const sample_cursor &c) const
+      -> std::array<double, 2> override {
+    auto a = random_double();
+    return {a, random_double()};
+  }
+};
+
+/**
+ * @class sobol_sampler
+ * @brief 按维度补齐的 Owen 打乱 Sobol：每次取数只用 Sobol 的前一或两维，
+ *        不同维度之间靠按 (像素, 维度) 打乱采样序号去相关。前两维是 (0, 2) 序列，
+ *        采样数为 2 的幂时每个二维投影都是分层的
+ */
+class sobol_sampler final : public sampler {
+public:
+  [[nodiscard]] auto get_1d(const sample_cursor &c) const -> double override {
+    using namespace sampler_detail;
+    auto seed = dim_seed(c.seed, c.dim);
+    auto i = owen_scramble(c.index, seed);
+    return to_unit(owen_scramble(sobol(i, 0), seed ^ 0x9e3779b9u));
+  }
+  [[nodiscard]] auto get_2d(const sample_cursor &c) const -> std::array<double, 2> override {
+    using namespace sampler_detail;
+    auto seed = dim_seed(c.seed, c.dim);
+    auto i = owen_scramble(c.index, seed);
+    return {to_unit(owen_scramble(sobol(i, 0), seed ^ 0x9e3779b9u)),
+        to_unit(owen_scramble(sobol(i, 1), seed ^ 0x7f4a7c15u))};
+  }
+};
+
+/**
+ * @class halton_sampler
+ * @brief Owen 打乱的 Halton：第 d 维为以第 d 个质数为底的根式反演，每一位数字按
+ *        (像素, 维度, 它之前的各位) 决定的随机仿射置换 (a * digit + b) mod 底 重排
+ *        （底为质数，a 不为 0 时是置换）。超出质数表的维度用独立随机数
+ */
+class halton_sampler final : public sampler {
+public:
+  [[nodiscard]] auto get_1d(const sample_cursor &c) const -> double override {
+    return radical_inverse(c, c.dim);
+  }
+  [[nodiscard]] auto get_2d(const sample_cursor &c) const -> std::array<double, 2> override {
+    return {radical_inverse(c, c.dim), radical_inverse(c, c.dim + 1)};
+  }
+
+private:
+  std::vector<uint32_t> primes = first_primes(1024);
+
+  static auto first_primes(uint32_t count) -> std::vector<uint32_t> {
+    std::vector<uint32_t> out;
+    for (uint32_t p = 2; out.size() < count; ++p) {
+      if (std::none_of(out.begin(), out.end(), [p](uint32_t q) { return p % q == 0; }))
+        out.push_back(p);
+    }
+    return out;
+  }
+  [[nodiscard]] auto radical_inverse(const sample_cursor &c, uint32_t dim) const -> double {
+    using namespace sampler_detail;
+    if (dim >= primes.size())
+      return random_double();
+    auto seed = dim_seed(c.seed, dim);
+    auto base = primes[dim];
+    // 底为 2 时即 Sobol 的第 0 维，位运算打乱
+    if (base == 2)
+      return to_unit(owen_scramble(reverse_bits(c.index), seed));
+    double inv_base = 1.0 / base, scale = inv_base, result = 0;
+    uint32_t node = 1; // 数字树上的结点：已经读过的各位
+    // 下标的各位之后再多打乱 2 位补的 0，保证与之后的采样分在不同的格子里；
+    // 更低的各位在 Owen 打乱下是均匀随机的，直接用哈希值代替
+    uint32_t index = c.index, zeros = 0;
+    for (; (index != 0 || zeros < 2) && scale > 0x1p-32; scale *= inv_base, index /= base) {
+      uint32_t digit = index % base;
+      zeros += index == 0;
+      auto h = hash32(node ^ seed);
+      result += ((1 + h % (base - 1)) * digit + (h >> 16) % base) % base * scale;
+      node = node * base + digit;
+    }
+    result += to_unit(hash32(node * 0x9e3779b9u ^ seed)) * scale * base;
+    return std::min(result, 1 - 0x1p-53);
+  }
+};
+
+constexpr uint32_t blue_noise_size = 64; // 蓝噪声贴图边长（2 的幂）
+
+/**
+ * @brief 用 void-and-cluster 生成 blue_noise_size^2 的蓝噪声贴图，值为 [0, 1) 上均匀的排名
+ *
+ * 能量为环面上的高斯核（sigma = 1.5）之和：先把初始的随机点集迭代到均匀，
+ * 再依次去掉最密的点（排名递减）、往最大的空隙里填点（排名递增）
+ */
+inline auto build_blue_noise() -> std::vector<float> {
+  constexpr uint32_t N = blue_noise_size, n = N * N;
+  std::vector<double> kernel(n);
+  for (uint32_t dy = 0; dy < N; ++dy) {
+    for (uint32_t dx = 0; dx < N; ++dx) {
+      double x = std::min(dx, N - dx), y = std::min(dy, N - dy);
+      kernel[dy * N + dx] = std::exp(-(x * x + y * y) / (2 * 1.5 * 1.5));
+    }
+  }
+  std::vector<uint8_t> on(n, 0);
+  std::vector<double> energy(n, 0);
+  auto toggle = [&](uint32_t p) {
+    on[p] ^= 1;
+    double sign = on[p] ? 1 : -1;
+    uint32_t px = p % N, py = p / N;
+    for (uint32_t q = 0; q < n; ++q)
+      energy[q] += sign * kernel[((q / N - py) & (N - 1)) * N + ((q % N - px) & (N - 1))];
+  };
+  auto tightest = [&] {
+    uint32_t best = 0;
+    double e = -infinity;
+    for (uint32_t p = 0; p < n; ++p) {
+      if (on[p] && energy[p] > e)
+        e = energy[p], best = p;
+    }
+    return best;
+  };
+  auto largest_void = [&] {
+    uint32_t best = 0;
+    double e = infinity;
+    for (uint32_t p = 0; p < n; ++p) {
+      if (!on[p] && energy[p] < e)
+        e = energy[p], best = p;
+    }
+    return best;
+  };
+  pcg32 rng(0x5eed, 0);
+  uint32_t count = 0;
+  while (count < n / 10) {
+    auto p = rng.next_bounded(n);
+    if (!on[p])
+      toggle(p), ++count;
+  }
+  // 最密的点移到最大的空隙，直到移走的点又回到原处
+  for (uint32_t iter = 0; iter < n; ++iter) {
+    auto c = tightest();
+    toggle(c);
+    auto v = largest_void();
+    toggle(v);
+    if (v == c)
+      break;
+  }
+  auto initial = on;
+  auto initial_energy = energy;
+  std::vector<uint32_t> rank(n);
+  for (auto r = count; r-- > 0;) {
+    auto c = tightest();
+    toggle(c);
+    rank[c] = r;
+  }
+  on.swap(initial), energy.swap(initial_energy);
+  for (auto r = count; r < n; ++r) {
+    auto v = largest_void();
+    toggle(v);
+    rank[v] = r;
+  }
+  std::vector<float> mask(n);
+  for (uint32_t p = 0; p < n; ++p)
+    mask[p] = (rank[p] + 0.5f) / n;
+  return mask;
+}
+
+/**
+ * @class blue_noise_sampler
+ * @brief 蓝噪声抖动：所有像素共用同一个 Owen 打乱的 Sobol 序列（打乱只与维度有关），
+ *        第 d 维的样本再加上蓝噪声贴图在 (x, y) 处的值取小数部分（每一维贴图平移不同）。
+ *        相邻像素的样本错开，少量采样时误差集中在高频，看起来比白噪声干净
+ */
+class blue_noise_sampler final : public sampler {
+public:
+  blue_noise_sampler() : mask(build_blue_noise()) {}
+
+  [[nodiscard]] auto get_1d(const sample_cursor &c) const -> double override {
+    using namespace sampler_detail;
+    auto seed = dim_seed(scene_seed(), c.dim);
+    auto i = owen_scramble(c.index, seed);
+    return dither(owen_scramble(sobol(i, 0), seed ^ 0x9e3779b9u), c, seed);
+  }
+  [[nodiscard]] auto get_2d(const sample_cursor &c) const -> std::array<double, 2> override {
+    using namespace sampler_detail;
+    auto seed = dim_seed(scene_seed(), c.dim);
+    auto i = owen_scramble(c.index, seed);
+    return {dither(owen_scramble(sobol(i, 0), seed ^ 0x9e3779b9u), c, seed),
+        dither(owen_scramble(sobol(i, 1), seed ^ 0x7f4a7c15u), c, seed >> 12)};
+  }
+
+private:
+  std::vector<float> mask;
+
+  // 按 offset 平移贴图后取 (x, y) 处的值，加到样本上并回绕到 [0, 1)
+  [[nodiscard]] auto dither(uint32_t x, const sample_cursor &c, uint32_t offset) const
+      -> double {
+    constexpr uint32_t wrap = blue_noise_size - 1;
+    auto mx = (c.x + offset) & wrap, my = (c.y + (offset >> 6)) & wrap;
+    auto shift = static_cast<uint32_t>(double(mask[my * blue_noise_size + mx]) * 0x1p32);
+    return sampler_detail::to_unit(x + shift);
+  }
+};
+
+/**
+ * @brief 当前场景使用的采样器，场景 JSON 中的 "sampler"
+ */
+inline auto active_sampler() -> std::unique_ptr<sampler> & {
+  static std::unique_ptr<sampler> s = std::make_unique<random_sampler>();
+  return s;
+}
+inline auto set_sampler(sampler_type type) -> void {
+  switch (type) {
+  case sampler_type::Sobol:
+    active_sampler() = std::make_unique<sobol_sampler>();
+    break;
+  case sampler_type::Halton:
+    active_sampler() = std::make_unique<halton_sampler>();
+    break;
+  case sampler_type::BlueNoise:
+    active_sampler() = std::make_unique<blue_noise_sampler>();
+    break;
+  default:
+    active_sampler() = std::make_unique<random_sampler>();
+  }
+}
+
+/**
+ * @brief 线程私有的采样游标
+ */
+inline auto thread_cursor() -> sample_cursor & {
+  thread_local sample_cursor cursor;
+  return cursor;
+}
+
+/**
+ * @brief 开始像素 (x, y) 的第 index 个采样：切换随机序列（见 seed_sample_stream），
+ *        维度从相机光线开始
+ */
+inline auto start_pixel_sample(uint32_t x, uint32_t y, uint32_t index) -> void {
+  seed_sample_stream(x, y, index);
+  uint64_t pixel = (uint64_t(y) << 32 | x) + 1;
+  auto seed = static_cast<uint32_t>(mix_bits(random_seed() ^ mix_bits(pixel)));
+  thread_cursor() = {x, y, index, 0, camera_dims, seed};
+}
+/**
+ * @brief 开始第 bounce 次弹射：每次弹射从固定的维度开始取数，
+ *        不同分支取数个数不同也不会错开后面的弹射
+ */
+inline auto start_bounce(int bounce) -> void {
+  auto &c = thread_cursor();
+  c.dim = camera_dims + static_cast<uint32_t>(bounce) * bounce_dims;
+  c.end = c.dim + bounce_dims;
+}
+
+/**
+ * @brief 取当前维度的一维样本 [0, 1)；本次弹射预留的维度用完后返回独立随机数
+ */
+inline auto sample_1d() -> double {
+  auto &c = thread_cursor();
+  if (c.dim >= c.end)
+    return random_double();
+  auto u = active_sampler()->get_1d(c);
+  ++c.dim;
+  return u;
+}
+/**
+ * @brief 取当前两个维度的二维样本 [0, 1)^2
+ */
+inline auto sample_2d() -> std::array<double, 2> {
+  auto &c = thread_cursor();
+  if (c.dim + 2 > c.end) {
+    auto a = random_double();
+    return {a, random_double()};
+  }
+  auto u = active_sampler()->get_2d(c);
+  c.dim += 2;
+  return u;
+}
+
+/**
+ * @class sample_stream
+ * @brief 一个采样的随机数状态与采样游标；光线包和 wavefront 引擎逐条着色前换上各自的状态
+ */
+struct sample_stream {
+  pcg32 rng;
+  sample_cursor cursor;
+
+  static auto save() -> sample_stream {
+    return {thread_rng(), thread_cursor()};
+  }
+  auto restore() const -> void {
+    thread_rng() = rng;
+    thread_cursor() = cursor;
+  }
+};
+
+#endif
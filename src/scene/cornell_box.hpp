@@ -7,7 +7,7 @@
 #include "../geometry/BVH.hpp"
 #include "../geometry/quad.hpp"
 #include "../geometry/sphere.hpp"
-#include "../geometry/translate.hpp"
+#include "../geometry/instance.hpp"
 #include "../geometry/meshTriangle.hpp"
 #include "../geometry/constant_medium.hpp"
 #include "../material/diffuse_light.hpp"
@@ -44,18 +44,17 @@ auto cornell_box_new(hittable_list &world, hittable_list &lights) -> void {
   auto aluminum = new metal(color(0.8, 0.85, 0.88), 0.0);
   auto box1 = std::make_unique<box>(point3(0, 0, 0), point3(165, 330, 165), aluminum);
   // auto box1 = new box(point3(0,0,0), point3(165,330,165), white);
-  auto box2 = std::make_unique<rotate_y>(std::move(box1), 15);
-  world.add(std::make_unique<translate>(std::move(box2), vec3d(265, 0, 295)));
+  world.add(std::make_unique<instance>(
+      std::move(box1), affine3::translate(vec3d(265, 0, 295)) * affine3::rotate(1, 15)));
 
   // Glass Sphere
   auto glass = new dielectric(1.5);
   world.add(std::make_unique<sphere>(point3(190, 90, 190), 90, glass));
 
-  // Light Sources
-  auto m = nullptr;
-  lights.add(
-      std::make_unique<quad>(point3(343, 554, 332), vec3d(-130, 0, 0), vec3d(0, 0, -105), m));
-  lights.add(std::make_unique<sphere>(point3(190, 90, 190), 90, m));
+  // Light Sources：带上与 world 中相同的材质，NEE 要在光源上求自发光
+  lights.add(std::make_unique<quad>(
+      point3(343, 554, 332), vec3d(-130, 0, 0), vec3d(0, 0, -105), wlight));
+  lights.add(std::make_unique<sphere>(point3(190, 90, 190), 90, glass));
 }
 
 auto cornell_box(hittable_list &world, hittable_list &light) -> void {
@@ -68,9 +67,8 @@ auto cornell_box(hittable_list &world, hittable_list &light) -> void {
       std::make_unique<quad>(point3(555, 0, 0), point3(0, 0, 555), point3(0, 555, 0), green));
   // world.add(std::make_unique<yz_rect>(0, 555, 0, 555, 555, green));
   world.add(std::make_unique<yz_rect>(0, 555, 0, 555, 0, red));
-  auto m = nullptr;
-  light.add(
-      std::make_unique<quad>(point3(343, 554, 332), vec3d(-130, 0, 0), vec3d(0, 0, -105), m));
+  light.add(std::make_unique<quad>(
+      point3(343, 554, 332), vec3d(-130, 0, 0), vec3d(0, 0, -105), wlight));
   world.add(std::make_unique<quad>(
       point3(343, 554, 332), vec3d(-130, 0, 0), vec3d(0, 0, -105), wlight));
   world.add(std::make_unique<xz_rect>(0, 555, 0, 555, 0, white));
@@ -86,9 +84,8 @@ auto cornell_box_rotate(hittable_list &world, hittable_list &light) -> void {
 
   world.add(std::make_unique<yz_rect>(0, 555, 0, 555, 555, green));
   world.add(std::make_unique<yz_rect>(0, 555, 0, 555, 0, red));
-  auto m = nullptr;
-  light.add(
-      std::make_unique<quad>(point3(343, 554, 332), vec3d(-130, 0, 0), vec3d(0, 0, -105), m));
+  light.add(std::make_unique<quad>(
+      point3(343, 554, 332), vec3d(-130, 0, 0), vec3d(0, 0, -105), wlight));
   world.add(std::make_unique<quad>(
       point3(343, 554, 332), vec3d(-130, 0, 0), vec3d(0, 0, -105), wlight));
   // light.add(new xz_rect(213, 343, 227, 332, 554, wlight));
@@ -97,12 +94,12 @@ auto cornell_box_rotate(hittable_list &world, hittable_list &light) -> void {
   world.add(std::make_unique<xy_rect>(0, 555, 0, 555, 555, white));
 
   auto box1 = std::make_unique<box>(point3(0, 0, 0), point3(165, 330, 165), white);
-  auto box11 = std::make_unique<rotate_y>(std::move(box1), 15);
-  world.add(std::make_unique<translate>(std::move(box11), vec3d(265, 0, 295)));
+  world.add(std::make_unique<instance>(
+      std::move(box1), affine3::translate(vec3d(265, 0, 295)) * affine3::rotate(1, 15)));
 
   auto box2 = std::make_unique<box>(point3(0, 0, 0), point3(165, 165, 165), white);
-  auto box22 = std::make_unique<rotate_y>(std::move(box2), -18);
-  world.add(std::make_unique<translate>(std::move(box22), vec3d(130, 0, 65)));
+  world.add(std::make_unique<instance>(
+      std::move(box2), affine3::translate(vec3d(130, 0, 65)) * affine3::rotate(1, -18)));
 }
 
 auto cornell_smoke(hittable_list &world, hittable_list &light) -> void {
@@ -114,9 +111,8 @@ auto cornell_smoke(hittable_list &world, hittable_list &light) -> void {
 
   world.add(std::make_unique<yz_rect>(0, 555, 0, 555, 555, green));
   world.add(std::make_unique<yz_rect>(0, 555, 0, 555, 0, red));
-  auto m = nullptr;
-  light.add(
-      std::make_unique<quad>(point3(343, 554, 332), vec3d(-130, 0, 0), vec3d(0, 0, -105), m));
+  light.add(std::make_unique<quad>(
+      point3(343, 554, 332), vec3d(-130, 0, 0), vec3d(0, 0, -105), wlight));
   world.add(std::make_unique<quad>(
       point3(343, 554, 332), vec3d(-130, 0, 0), vec3d(0, 0, -105), wlight));
   // light.add(new xz_rect(213, 343, 227, 332, 554, wlight));
@@ -124,15 +120,13 @@ auto cornell_smoke(hittable_list &world, hittable_list &light) -> void {
   world.add(std::make_unique<xz_rect>(0, 555, 0, 555, 555, white));
   world.add(std::make_unique<xy_rect>(0, 555, 0, 555, 555, white));
 
-  auto box1 = std::make_unique<translate>(
-      std::make_unique<rotate_y>(
-          std::make_unique<box>(point3(0, 0, 0), point3(165, 330, 165), white), 15),
-      vec3d(265, 0, 295));
+  auto box1 = std::make_unique<instance>(
+      std::make_unique<box>(point3(0, 0, 0), point3(165, 330, 165), white),
+      affine3::translate(vec3d(265, 0, 295)) * affine3::rotate(1, 15));
 
-  auto box2 = std::make_unique<translate>(
-      std::make_unique<rotate_y>(
-          std::make_unique<box>(point3(0, 0, 0), point3(165, 165, 165), white), -18),
-      vec3d(130, 0, 65));
+  auto box2 = std::make_unique<instance>(
+      std::make_unique<box>(point3(0, 0, 0), point3(165, 165, 165), white),
+      affine3::translate(vec3d(130, 0, 65)) * affine3::rotate(1, -18));
   // world.add(std::move(box1));
   // world.add(std::move(box2));
   world.add(std::make_unique<constant_medium>(std::move(box1), 0.01, color(0, 0, 0)));
@@ -160,7 +154,7 @@ auto total_texture(hittable_list &world, hittable_list &light) -> void {
   world.add(std::make_unique<bvh_node>(boxes1));
   auto wlight = new diffuse_light(color(7, 7, 7));
   light.add(std::make_unique<quad>(
-      point3(123, 554, 147), vec3d(300, 0, 0), vec3d(0, 0, 265), nullptr));
+      point3(123, 554, 147), vec3d(300, 0, 0), vec3d(0, 0, 265), wlight));
   world.add(std::make_unique<quad>(
       point3(123, 554, 147), vec3d(300, 0, 0), vec3d(0, 0, 265), wlight));
   // light.add(std::make_unique<xz_rect>(123, 423, 147, 412, 554, wlight));
@@ -192,9 +186,8 @@ auto total_texture(hittable_list &world, hittable_list &light) -> void {
     boxes2.add(std::make_unique<sphere>(point3::random(0, 165), 10, white));
   }
 
-  world.add(std::make_unique<translate>(
-      std::make_unique<rotate_y>(std::make_unique<bvh_node>(boxes2), 15),
-      vec3d(-100, 270, 395)));
+  world.add(std::make_unique<instance>(std::make_unique<bvh_node>(boxes2),
+      affine3::translate(vec3d(-100, 270, 395)) * affine3::rotate(1, 15)));
 }
 
 auto cornell_box_bunny_rotate(hittable_list &world, hittable_list &light) -> void {
@@ -207,9 +200,8 @@ auto cornell_box_bunny_rotate(hittable_list &world, hittable_list &light) -> voi
 
   world.add(std::make_unique<yz_rect>(0, 555, 0, 555, 555, green));
   world.add(std::make_unique<yz_rect>(0, 555, 0, 555, 0, red));
-  auto m = nullptr;
-  light.add(
-      std::make_unique<quad>(point3(343, 554, 332), vec3d(-130, 0, 0), vec3d(0, 0, -105), m));
+  light.add(std::make_unique<quad>(
+      point3(343, 554, 332), vec3d(-130, 0, 0), vec3d(0, 0, -105), wlight));
   world.add(std::make_unique<quad>(
       point3(343, 554, 332), vec3d(-130, 0, 0), vec3d(0, 0, -105), wlight));
   world.add(std::make_unique<xz_rect>(0, 555, 0, 555, 0, white));
@@ -218,40 +210,33 @@ auto cornell_box_bunny_rotate(hittable_list &world, hittable_list &light) -> voi
 
   // auto aluminum = new metal(color(0.8, 0.85, 0.88), 0.0);
   // auto box1 = new box(point3(0,0,0), point3(165,330,165), aluminum);
-  auto box1 = std::make_unique<translate>(
-      std::make_unique<rotate_y>(
-          std::make_unique<box>(point3(0, 0, 0), point3(165, 330, 165), white), 30),
-      vec3d(265, 0, 295));
+  auto box1 = std::make_unique<instance>(
+      std::make_unique<box>(point3(0, 0, 0), point3(165, 330, 165), white),
+      affine3::translate(vec3d(265, 0, 295)) * affine3::rotate(1, 30));
   world.add(std::move(box1));
 
-  auto box2 = std::make_unique<translate>(
-      std::make_unique<rotate_y>(
-          std::make_unique<box>(point3(0, 0, 0), point3(165, 165, 165), white), -18),
-      vec3d(130, 0, 65));
+  auto box2 = std::make_unique<instance>(
+      std::make_unique<box>(point3(0, 0, 0), point3(165, 165, 165), white),
+      affine3::translate(vec3d(130, 0, 65)) * affine3::rotate(1, -18));
   world.add(std::move(box2));
 
   auto bunny = MeshTriangle("src/models/bunny/bunny.obj", 60.0f);
   std::cout << "bunny bounding box : " << bunny.bbox.min() << "    ||    " << bunny.bbox.max()
             << std::endl;
-  auto bigbunny = std::make_unique<scale>(
-      std::make_unique<rotate_y>(std::make_unique<bvh_node>(bunny.triangles), 180),
-      vec3d(15, 15, 15));
-  aabb bunnyaabb = bigbunny->bounding_box();
-  auto center = bunnyaabb.center();
-  auto box = std::make_unique<translate>(std::move(bigbunny), vec3d(330 + center[0], 300, 400));
-  world.add(std::move(box));
+  // 旋转 180 度并放大后，按变换后包围盒的中心平移（该变换把包围盒中心映到新的中心）
+  auto bunny_local = affine3::scale(vec3d(15, 15, 15)) * affine3::rotate(1, 180);
+  auto center = bunny_local.point(bunny.bbox.center());
+  world.add(std::make_unique<instance>(std::make_unique<bvh_node>(bunny.triangles),
+      affine3::translate(vec3d(330 + center[0], 300, 400)) * bunny_local));
   auto cow_texture = new image_texture("src/models/spot/spot_texture.png");
   auto cow_surface = new lambertian(cow_texture);
   auto cow = MeshTriangle("src/models/spot/spot_triangulated_good.obj", 80, cow_surface);
   // auto cow = MeshTriangle("src/models/spot/spot_triangulated_good.obj", 4);
   std::cout << "cow bounding box : " << cow.bbox.min() << "    ||    " << cow.bbox.max()
             << std::endl;
-  auto rotatecow = std::make_unique<rotate_y>(std::make_unique<bvh_node>(cow.triangles), 45);
-  aabb cowab = rotatecow->bounding_box();
-
-  auto boxcow =
-      std::make_unique<translate>(std::move(rotatecow), vec3d(165, 165 - cowab.min()[1], 145));
-  world.add(std::move(boxcow));
+  // 绕 y 轴旋转不改变 y 坐标，平移后底面落在 y = 165
+  world.add(std::make_unique<instance>(std::make_unique<bvh_node>(cow.triangles),
+      affine3::translate(vec3d(165, 165 - cow.bbox.min()[1], 145)) * affine3::rotate(1, 45)));
 }
 
 #endif
@@ -2,6 +2,8 @@
 #define SCENE_HPP
 
 #include "../geometry/hittablelist.hpp"
+#include "../geometry/accel.hpp"
+#include "../geometry/triangle_mesh.hpp"
 #include "balls_world.hpp"
 #include "cornell_box.hpp"
 #include "test_scene.hpp"
@@ -82,6 +84,42 @@ enum TEXTURE {
 std::map<std::string, int> texture_map = {
     {"Color", Color}, {"Checker", Checker}, {"Image", Image}, {"Noise", Noise}};
 
+std::map<std::string, bvh_split> bvh_split_map = {
+    {"SAH", bvh_split::SAH},
+    {"Median", bvh_split::Median},
+    {"sah", bvh_split::SAH},
+    {"median", bvh_split::Median},
+};
+
+std::map<std::string, bvh_layout> bvh_layout_map = {
+    {"Tree", bvh_layout::Tree},
+    {"Flat", bvh_layout::Flat},
+    {"BVH4", bvh_layout::Wide},
+    {"tree", bvh_layout::Tree},
+    {"flat", bvh_layout::Flat},
+    {"bvh4", bvh_layout::Wide},
+};
+
+std::map<std::string, integrator_type> integrator_map = {
+    {"Recursive", integrator_type::Recursive},
+    {"Path", integrator_type::Path},
+    {"NEE", integrator_type::NEE},
+    {"recursive", integrator_type::Recursive},
+    {"path", integrator_type::Path},
+    {"nee", integrator_type::NEE},
+};
+
+std::map<std::string, sampler_type> sampler_map = {
+    {"Random", sampler_type::Random},
+    {"Sobol", sampler_type::Sobol},
+    {"Halton", sampler_type::Halton},
+    {"BlueNoise", sampler_type::BlueNoise},
+    {"random", sampler_type::Random},
+    {"sobol", sampler_type::Sobol},
+    {"halton", sampler_type::Halton},
+    {"bluenoise", sampler_type::BlueNoise},
+};
+
 inline auto choose_scene(uint32_t opt, hittable_list &world, hittable_list &light,
     double &aspect_ratio, uint32_t &image_width, double &vfov, point3 &lookfrom, point3 &lookat, point3 &vup,
     color &background) -> void {
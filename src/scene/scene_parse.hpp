@@ -8,8 +8,11 @@
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <set>
+#include <string_view>
+#include <tuple>
 #include <unordered_map>
 #include <utility>
 
@@ -18,6 +21,9 @@
 #include "../renderer/Renderer.hpp"
 #include "scene.hpp"
 
+// 顶层物体多于这个数时为 world 建一层 BVH（TLAS），否则逐个求交更快
+constexpr size_t world_bvh_threshold = 4;
+
 class scene {
 private:
   // use exsit scene
@@ -40,17 +46,40 @@ private:
   std::uint32_t max_depth;
   std::uint32_t pps;
   std::uint32_t threads;
+  std::uint32_t tile_size;
+  bvh_split split_method;
+  bvh_layout layout;
+  integrator_type integrator;
+  sampler_type sampler_kind;
+  double adaptive_threshold;
+  std::uint32_t min_pps;
+  std::uint32_t max_pps;
+  std::uint32_t progressive_pps;
+  double snapshot_interval;
+  double checkpoint_interval;
+  std::string checkpoint_path;
+  double time_budget;
+  bool use_mesh_cache;
+  std::string mesh_cache_dir;
+  bool packet_tracing;
+  bool wavefront;
+  std::uint32_t rr_depth;
+  std::uint64_t scene_hash; // 各 JSON 文件中影响采样结果的内容的哈希，用于校验断点
   std::unique_ptr<Renderer<camera>> renderer;
   // json parse
   cJSON *root;
   std::set<std::string> json_set;
   std::unordered_map<std::string, texture *> tex_map;
   std::unordered_map<std::string, material *> mat_map;
+  // 网格缓存：同一文件、缩放、法线插值、划分方式和精度的网格只加载、建树一次
+  using mesh_key = std::tuple<std::string, double, bool, bvh_split, bool>;
+  std::map<mesh_key, std::shared_ptr<const triangle_mesh>> mesh_map;
 
 private:
   // basic
   auto parse_vec3d(cJSON *) -> std::pair<std::string, vec3d>;
   // parse
+  auto hash_scene(const cJSON *sub_root) -> void;
   auto parse_inherit(cJSON *sub_root) -> void;
   auto parse_scene_id(cJSON *sub_root) -> void;
   auto parse_image_name(cJSON *sub_root) -> void;
@@ -63,11 +92,31 @@ private:
   auto parse_texture(cJSON *sub_root) -> void;
   auto parse_material(cJSON *sub_root) -> void;
   auto parse_object_once(cJSON *item) -> std::unique_ptr<hittable>;
+  auto parse_transform(cJSON *item) -> std::unique_ptr<hittable>;
   auto parse_object(cJSON *sub_root) -> void;
   auto parse_background(cJSON *sub_root) -> void;
   auto parse_max_depth(cJSON *sub_root) -> void;
   auto parse_pps(cJSON *sub_root) -> void;
   auto parse_threads(cJSON *sub_root) -> void;
+  auto parse_tile_size(cJSON *sub_root) -> void;
+  auto parse_bvh_split(cJSON *sub_root) -> void;
+  auto object_split(cJSON *item) -> bvh_split;
+  auto parse_bvh_layout(cJSON *sub_root) -> void;
+  auto build_bvh(hittable_list &list, cJSON *item) -> std::unique_ptr<hittable>;
+  auto parse_integrator(cJSON *sub_root) -> void;
+  auto parse_seed(cJSON *sub_root) -> void;
+  auto parse_adaptive(cJSON *sub_root) -> void;
+  auto parse_progressive(cJSON *sub_root) -> void;
+  auto parse_checkpoint(cJSON *sub_root) -> void;
+  auto parse_time_budget(cJSON *sub_root) -> void;
+  auto parse_mesh_cache(cJSON *sub_root) -> void;
+  auto parse_packet_tracing(cJSON *sub_root) -> void;
+  auto parse_wavefront(cJSON *sub_root) -> void;
+  auto parse_sampler(cJSON *sub_root) -> void;
+  auto check_settings() const -> bool;
+  auto build_world_bvh() -> void;
+  auto build_mesh(const std::string &file, double scale, material *mat, cJSON *item)
+      -> std::unique_ptr<hittable>;
 
 public:
   scene() {
@@ -84,7 +133,25 @@ public:
     background = color(0.0, 0.0, 0.0);
     max_depth = 5;
     pps = 64;
-    threads = 64;
+    threads = 0; // 0 : 使用硬件线程数
+    tile_size = 16;
+    split_method = bvh_split::SAH;
+    layout = bvh_layout::Flat;
+    integrator = integrator_type::Recursive;
+    sampler_kind = sampler_type::Random;
+    rr_depth = 3;
+    scene_hash = 0;
+    adaptive_threshold = 0;
+    min_pps = 16;
+    max_pps = 0;
+    progressive_pps = 0;
+    snapshot_interval = 0;
+    checkpoint_interval = 0;
+    time_budget = 0;
+    use_mesh_cache = true;
+    mesh_cache_dir = mesh_cache_default_dir;
+    packet_tracing = true;
+    wavefront = false;
     world = new hittable_list();
     light = new hittable_list();
   }
@@ -92,6 +159,15 @@ public:
   auto scene_parse(const std::string &json_path) -> bool;
   auto scene_parse_sub(const std::string &json_path) -> bool;
   auto generate() -> void;
+  // 从断点继续渲染（命令行 --resume）；自适应采样不读写断点，两者同时使用时失败
+  auto set_resume(bool flag) -> bool {
+    if (flag && adaptive_threshold > 0) {
+      std::cerr << "--resume can not be used with adaptive_threshold\n";
+      return false;
+    }
+    renderer->set_resume(flag);
+    return true;
+  }
   auto generate_single_thread() -> void;
 };
 
@@ -481,7 +557,7 @@ auto scene::parse_object_once(cJSON *child) -> std::unique_ptr<hittable> {
           cJSON *obj = cJSON_GetArrayItem(list_raw, i);
           box.add(parse_object_once(obj));
         }
-        hit = std::make_unique<bvh_node>(box);
+        hit = build_bvh(box, child);
       } break;
       case Mesh: {
         auto file_raw = cJSON_GetObjectItem(child, "filename");
@@ -497,8 +573,7 @@ auto scene::parse_object_once(cJSON *child) -> std::unique_ptr<hittable> {
           auto find_mat = mat_map.find(material_raw->valuestring);
 
           if (find_mat != mat_map.end()) {
-            hit = std::make_unique<bvh_node>(
-                std::make_unique<MeshTriangle>(file, scale, find_mat->second)->triangles);
+            hit = build_mesh(file, scale, find_mat->second, child);
           } else {
             std::cerr << find_it->first << " can not find mat\n";
           }
@@ -526,62 +601,57 @@ auto scene::parse_object_once(cJSON *child) -> std::unique_ptr<hittable> {
           std::cerr << find_it->first << " lack of information\n";
         }
       } break;
-      case Trans: {
-        auto offset_raw = cJSON_GetObjectItem(child, "offset");
-        auto result = parse_vec3d(offset_raw);
-        auto obj = cJSON_GetObjectItem(child, "obj");
-        if (result.first == "" && obj) {
-          hit = std::make_unique<translate>(parse_object_once(obj), result.second);
-        } else {
-          std::cerr << find_it->first << " lack of information\n";
-        }
-      } break;
-      case Scale: {
-        auto offset_raw = cJSON_GetObjectItem(child, "offset");
-        auto result = parse_vec3d(offset_raw);
-        auto obj = cJSON_GetObjectItem(child, "obj");
-        if (result.first == "" && obj) {
-          hit = std::make_unique<scale>(parse_object_once(obj), result.second);
-        } else {
-          std::cerr << find_it->first << " lack of information\n";
-        }
-      } break;
-      case R_x: {
-        auto angle_raw = cJSON_GetObjectItem(child, "angle");
-        auto obj = cJSON_GetObjectItem(child, "obj");
-        if (angle_raw && obj) {
-
-          hit = std::make_unique<rotate_x>(parse_object_once(obj), angle_raw->valuedouble);
-        } else {
-          std::cerr << find_it->first << " lack of information\n";
-        }
-      } break;
-      case R_y: {
-        auto angle_raw = cJSON_GetObjectItem(child, "angle");
-        auto obj = cJSON_GetObjectItem(child, "obj");
-        if (angle_raw && obj) {
-
-          hit = std::make_unique<rotate_y>(parse_object_once(obj), angle_raw->valuedouble);
-        } else {
-          std::cerr << find_it->first << " lack of information\n";
-        }
-      } break;
-      case R_z: {
-        auto angle_raw = cJSON_GetObjectItem(child, "angle");
-        auto obj = cJSON_GetObjectItem(child, "obj");
-        if (angle_raw && obj) {
-
-          hit = std::make_unique<rotate_z>(parse_object_once(obj), angle_raw->valuedouble);
-        } else {
-          std::cerr << find_it->first << " lack of information\n";
-        }
-      } break;
+      case Trans:
+      case Scale:
+      case R_x:
+      case R_y:
+      case R_z:
+        hit = parse_transform(child);
+        break;
       }
     }
   }
   return hit;
 }
 
+/**
+ * @brief 把连续嵌套的 Trans / Scale / R_x / R_y / R_z 合并成一个 instance
+ *
+ * 外层的变换最后作用，所以沿着 "obj" 向内依次右乘，遇到第一个非变换物体时停下
+ */
+auto scene::parse_transform(cJSON *child) -> std::unique_ptr<hittable> {
+  affine3 transform;
+  while (child != nullptr) {
+    auto type = cJSON_GetObjectItem(child, "type");
+    auto find_it = type != nullptr ? obj_map.find(type->valuestring) : obj_map.end();
+    if (find_it == obj_map.end() || find_it->second < Trans) {
+      auto hit = parse_object_once(child);
+      if (hit == nullptr)
+        return nullptr;
+      return std::make_unique<instance>(std::move(hit), transform);
+    }
+    if (find_it->second == Trans || find_it->second == Scale) {
+      auto result = parse_vec3d(cJSON_GetObjectItem(child, "offset"));
+      if (result.first != "") {
+        std::cerr << find_it->first << " lack of information\n";
+        return nullptr;
+      }
+      transform = transform * (find_it->second == Trans ? affine3::translate(result.second)
+                                                        : affine3::scale(result.second));
+    } else {
+      auto angle_raw = cJSON_GetObjectItem(child, "angle");
+      if (angle_raw == nullptr) {
+        std::cerr << find_it->first << " lack of information\n";
+        return nullptr;
+      }
+      transform = transform * affine3::rotate(find_it->second - R_x, angle_raw->valuedouble);
+    }
+    child = cJSON_GetObjectItem(child, "obj");
+  }
+  std::cerr << "transform lack of 'obj'\n";
+  return nullptr;
+}
+
 auto scene::parse_object(cJSON *sub_root) -> void {
   parse_texture(sub_root);
   parse_material(sub_root);
@@ -624,9 +694,11 @@ auto scene::parse_object(cJSON *sub_root) -> void {
             std::cerr << find_it->first << " has error members! " << result.first << "\n";
           } else if (radius_raw && material_raw) {
             auto find_mat = mat_map.find(material_raw->valuestring);
+            // 光源列表中的副本也带上材质，NEE 要通过它取得光源的自发光
+            auto *light_mat = find_mat != mat_map.end() ? find_mat->second : nullptr;
             if (is_light) {
               light->add(
-                  std::make_unique<sphere>(result.second, radius_raw->valuedouble, nullptr));
+                  std::make_unique<sphere>(result.second, radius_raw->valuedouble, light_mat));
             }
             if (find_mat != mat_map.end()) {
               world->add(std::make_unique<sphere>(
@@ -652,9 +724,10 @@ auto scene::parse_object(cJSON *sub_root) -> void {
               exit(-1);
             }
             auto find_mat = mat_map.find(material_raw->valuestring);
+            auto *light_mat = find_mat != mat_map.end() ? find_mat->second : nullptr;
             if (is_light) {
               light->add(std::make_unique<triangle>(
-                  result0.second, result1.second, result2.second, nullptr));
+                  result0.second, result1.second, result2.second, light_mat));
             }
             if (find_mat != mat_map.end()) {
               world->add(std::make_unique<triangle>(
@@ -680,9 +753,10 @@ auto scene::parse_object(cJSON *sub_root) -> void {
               exit(-1);
             }
             auto find_mat = mat_map.find(material_raw->valuestring);
+            auto *light_mat = find_mat != mat_map.end() ? find_mat->second : nullptr;
             if (is_light) {
               light->add(std::make_unique<quad>(
-                  result0.second, result1.second, result2.second, nullptr));
+                  result0.second, result1.second, result2.second, light_mat));
             }
             if (find_mat != mat_map.end()) {
               world->add(std::make_unique<quad>(
@@ -711,7 +785,7 @@ auto scene::parse_object(cJSON *sub_root) -> void {
             cJSON *obj = cJSON_GetArrayItem(list_raw, i);
             box.add(parse_object_once(obj));
           }
-          world->add(std::make_unique<bvh_node>(box));
+          world->add(build_bvh(box, child));
         } break;
         case Mesh: {
           auto file_raw = cJSON_GetObjectItem(child, "filename");
@@ -725,13 +799,12 @@ auto scene::parse_object(cJSON *sub_root) -> void {
               exit(-1);
             }
             auto find_mat = mat_map.find(material_raw->valuestring);
+            auto *light_mat = find_mat != mat_map.end() ? find_mat->second : nullptr;
             if (is_light) {
-              light->add(std::make_unique<bvh_node>(
-                  std::make_unique<MeshTriangle>(file, scale, nullptr)->triangles));
+              light->add(build_mesh(file, scale, light_mat, child));
             }
             if (find_mat != mat_map.end()) {
-              world->add(std::make_unique<bvh_node>(
-                  std::make_unique<MeshTriangle>(file, scale, find_mat->second)->triangles));
+              world->add(build_mesh(file, scale, find_mat->second, child));
             } else if (!is_light) {
               std::cerr << find_it->first << " can not find mat\n";
             }
@@ -750,8 +823,9 @@ auto scene::parse_object(cJSON *sub_root) -> void {
               exit(-1);
             }
             auto find_mat = mat_map.find(material_raw->valuestring);
+            auto *light_mat = find_mat != mat_map.end() ? find_mat->second : nullptr;
             if (is_light) {
-              light->add(std::make_unique<box>(result0.second, result1.second, nullptr));
+              light->add(std::make_unique<box>(result0.second, result1.second, light_mat));
             }
             if (find_mat != mat_map.end()) {
               world->add(
@@ -763,55 +837,14 @@ auto scene::parse_object(cJSON *sub_root) -> void {
             std::cerr << find_it->first << " lack of information\n";
           }
         } break;
-        case Trans: {
-          auto offset_raw = cJSON_GetObjectItem(child, "offset");
-          auto result = parse_vec3d(offset_raw);
-          auto obj = cJSON_GetObjectItem(child, "obj");
-          if (result.first == "" && obj) {
-            world->add(std::make_unique<translate>(parse_object_once(obj), result.second));
-          } else {
-            std::cerr << find_it->first << " lack of information\n";
-          }
-        } break;
-        case Scale: {
-          auto offset_raw = cJSON_GetObjectItem(child, "offset");
-          auto result = parse_vec3d(offset_raw);
-          auto obj = cJSON_GetObjectItem(child, "obj");
-          if (result.first == "" && obj) {
-            world->add(std::make_unique<scale>(parse_object_once(obj), result.second));
-          } else {
-            std::cerr << find_it->first << " lack of information\n";
-          }
-        } break;
-        case R_x: {
-          auto angle_raw = cJSON_GetObjectItem(child, "angle");
-          auto obj = cJSON_GetObjectItem(child, "obj");
-          if (angle_raw && obj) {
-            world->add(
-                std::make_unique<rotate_x>(parse_object_once(obj), angle_raw->valuedouble));
-          } else {
-            std::cerr << find_it->first << " lack of information\n";
-          }
-        } break;
-        case R_y: {
-          auto angle_raw = cJSON_GetObjectItem(child, "angle");
-          auto obj = cJSON_GetObjectItem(child, "obj");
-          if (angle_raw && obj) {
-            world->add(
-                std::make_unique<rotate_y>(parse_object_once(obj), angle_raw->valuedouble));
-          } else {
-            std::cerr << find_it->first << " lack of information\n";
-          }
-        } break;
+        case Trans:
+        case Scale:
+        case R_x:
+        case R_y:
         case R_z: {
-          auto angle_raw = cJSON_GetObjectItem(child, "angle");
-          auto obj = cJSON_GetObjectItem(child, "obj");
-          if (angle_raw && obj) {
-            world->add(
-                std::make_unique<rotate_z>(parse_object_once(obj), angle_raw->valuedouble));
-          } else {
-            std::cerr << find_it->first << " lack of information\n";
-          }
+          auto inst = parse_transform(child);
+          if (inst != nullptr)
+            world->add(std::move(inst));
         } break;
         }
       }
@@ -847,12 +880,214 @@ auto scene::parse_pps(cJSON *sub_root) -> void {
     pps = item->valueint;
   }
 }
+// 自适应采样："adaptive_threshold" > 0 时开启，pps 变为平均每像素的采样预算
+auto scene::parse_adaptive(cJSON *sub_root) -> void {
+  auto item = cJSON_GetObjectItem(sub_root, "adaptive_threshold");
+  if (item != nullptr) {
+    adaptive_threshold = item->valuedouble;
+  }
+  item = cJSON_GetObjectItem(sub_root, "min_pps");
+  if (item != nullptr) {
+    min_pps = item->valueint;
+  }
+  item = cJSON_GetObjectItem(sub_root, "max_pps");
+  if (item != nullptr) {
+    max_pps = item->valueint;
+  }
+}
+// 渐进式渲染："progressive_pps" 为每轮的采样数，"snapshot_interval_s" 为写出快照的间隔
+auto scene::parse_progressive(cJSON *sub_root) -> void {
+  auto item = cJSON_GetObjectItem(sub_root, "progressive_pps");
+  if (item != nullptr) {
+    progressive_pps = item->valueint;
+  }
+  item = cJSON_GetObjectItem(sub_root, "snapshot_interval_s");
+  if (item != nullptr) {
+    snapshot_interval = item->valuedouble;
+  }
+}
+// 断点："checkpoint_interval_s" > 0 时定期写断点，"checkpoint" 为断点文件路径
+auto scene::parse_checkpoint(cJSON *sub_root) -> void {
+  auto item = cJSON_GetObjectItem(sub_root, "checkpoint_interval_s");
+  if (item != nullptr) {
+    checkpoint_interval = item->valuedouble;
+  }
+  item = cJSON_GetObjectItem(sub_root, "checkpoint");
+  if (item != nullptr) {
+    checkpoint_path = item->valuestring;
+  }
+}
+// 限时渲染："time_budget_s" 秒内尽量多采样，到点后输出图片
+auto scene::parse_time_budget(cJSON *sub_root) -> void {
+  auto item = cJSON_GetObjectItem(sub_root, "time_budget_s");
+  if (item != nullptr) {
+    time_budget = item->valuedouble;
+  }
+}
+// 顶层的摆放（mesh_ref、instance、球等）按 bvh_layout 和 bvh_split 建成上层 BVH，
+// 网格自己的 BVH 为下层；make_bvh 会移走 world 中的物体，只剩下这一个结点
+auto scene::build_world_bvh() -> void {
+  if (world->objects.size() <= world_bvh_threshold)
+    return;
+  auto tlas = make_bvh(*world, split_method, layout);
+  world->clear();
+  world->add(std::move(tlas));
+}
+// 自适应采样按块分批追加采样，不走渐进式渲染的轮次，不能与按轮次工作的设置同时使用
+auto scene::check_settings() const -> bool {
+  if (adaptive_threshold > 0 && progressive_pps > 0) {
+    std::cerr << "adaptive_threshold can not be combined with progressive_pps\n";
+    return false;
+  }
+  if (adaptive_threshold > 0 && time_budget > 0) {
+    std::cerr << "adaptive_threshold can not be combined with time_budget_s\n";
+    return false;
+  }
+  if (adaptive_threshold > 0 && checkpoint_interval > 0) {
+    std::cerr << "adaptive_threshold can not be combined with checkpoint_interval_s\n";
+    return false;
+  }
+  return true;
+}
+// "mesh_cache" 为 false 时不读写网格的二进制缓存，"mesh_cache_dir" 为缓存目录
+auto scene::parse_mesh_cache(cJSON *sub_root) -> void {
+  auto item = cJSON_GetObjectItem(sub_root, "mesh_cache");
+  if (item != nullptr) {
+    use_mesh_cache = cJSON_IsTrue(item);
+  }
+  item = cJSON_GetObjectItem(sub_root, "mesh_cache_dir");
+  if (item != nullptr && cJSON_IsString(item)) {
+    mesh_cache_dir = item->valuestring;
+  }
+}
+// "packet_tracing" 为 false 时相机光线逐条求交
+auto scene::parse_packet_tracing(cJSON *sub_root) -> void {
+  auto item = cJSON_GetObjectItem(sub_root, "packet_tracing");
+  if (item != nullptr) {
+    packet_tracing = cJSON_IsTrue(item);
+  }
+}
+// "wavefront" 为 true 时 Path / NEE 积分器按批分阶段追踪
+auto scene::parse_wavefront(cJSON *sub_root) -> void {
+  auto item = cJSON_GetObjectItem(sub_root, "wavefront");
+  if (item != nullptr) {
+    wavefront = cJSON_IsTrue(item);
+  }
+}
 auto scene::parse_threads(cJSON *sub_root) -> void {
   auto item = cJSON_GetObjectItem(sub_root, "threads");
   if (item != nullptr) {
     threads = item->valueint;
   }
 }
+auto scene::parse_bvh_split(cJSON *sub_root) -> void {
+  auto item = cJSON_GetObjectItem(sub_root, "bvh_split");
+  if (item != nullptr) {
+    auto find_it = bvh_split_map.find(item->valuestring);
+    if (find_it != bvh_split_map.end()) {
+      split_method = find_it->second;
+    } else {
+      std::cerr << "unknown bvh_split " << item->valuestring << "\n";
+    }
+  }
+}
+// BVH / Mesh 物体可以用 "split" 单独指定划分方式，否则使用全局的 bvh_split
+auto scene::object_split(cJSON *item) -> bvh_split {
+  auto split_raw = cJSON_GetObjectItem(item, "split");
+  if (split_raw != nullptr) {
+    auto find_it = bvh_split_map.find(split_raw->valuestring);
+    if (find_it != bvh_split_map.end())
+      return find_it->second;
+    std::cerr << "unknown split " << split_raw->valuestring << "\n";
+  }
+  return split_method;
+}
+auto scene::parse_bvh_layout(cJSON *sub_root) -> void {
+  auto item = cJSON_GetObjectItem(sub_root, "bvh_layout");
+  if (item != nullptr) {
+    auto find_it = bvh_layout_map.find(item->valuestring);
+    if (find_it != bvh_layout_map.end()) {
+      layout = find_it->second;
+    } else {
+      std::cerr << "unknown bvh_layout " << item->valuestring << "\n";
+    }
+  }
+}
+// 按全局的 bvh_layout 与物体的 split 构建 BVH
+auto scene::build_bvh(hittable_list &list, cJSON *item) -> std::unique_ptr<hittable> {
+  return make_bvh(list, object_split(item), layout);
+}
+// 网格自带线性 BVH，只受 "split" 影响；"smooth" 为 true 时使用顶点法线插值
+auto scene::build_mesh(const std::string &file, double scale, material *mat, cJSON *item)
+    -> std::unique_ptr<hittable> {
+  auto smooth_raw = cJSON_GetObjectItem(item, "smooth");
+  bool smooth = smooth_raw != nullptr && cJSON_IsTrue(smooth_raw);
+  // "precision": "float" 时顶点按 float 存放，先做单精度求交
+  auto precision_raw = cJSON_GetObjectItem(item, "precision");
+  bool single = precision_raw != nullptr && cJSON_IsString(precision_raw) &&
+                std::string(precision_raw->valuestring) == "float";
+  auto &mesh = mesh_map[std::make_tuple(file, scale, smooth, object_split(item), single)];
+  if (mesh == nullptr)
+    mesh = std::make_shared<triangle_mesh>(
+        file, scale, nullptr, object_split(item), smooth, use_mesh_cache ? mesh_cache_dir : "",
+        single);
+  return std::make_unique<mesh_ref>(mesh, mat);
+}
+// "integrator" 选择积分器，"rr_depth" 为 Path 积分器开始轮盘赌的弹射次数
+auto scene::parse_integrator(cJSON *sub_root) -> void {
+  auto item = cJSON_GetObjectItem(sub_root, "integrator");
+  if (item != nullptr) {
+    auto find_it = integrator_map.find(item->valuestring);
+    if (find_it != integrator_map.end()) {
+      integrator = find_it->second;
+    } else {
+      std::cerr << "unknown integrator " << item->valuestring << "\n";
+    }
+  }
+  auto rr_item = cJSON_GetObjectItem(sub_root, "rr_depth");
+  if (rr_item != nullptr) {
+    rr_depth = rr_item->valueint;
+  }
+}
+// "sampler" 选择像素、光圈、光源和 BSDF 采样所用的序列
+auto scene::parse_sampler(cJSON *sub_root) -> void {
+  auto item = cJSON_GetObjectItem(sub_root, "sampler");
+  if (item != nullptr) {
+    auto find_it = sampler_map.find(item->valuestring);
+    if (find_it != sampler_map.end()) {
+      sampler_kind = find_it->second;
+    } else {
+      std::cerr << "unknown sampler " << item->valuestring << "\n";
+    }
+  }
+}
+// "seed" 决定整张图的随机序列，同一种子的渲染结果与线程数、调度顺序无关
+auto scene::parse_seed(cJSON *sub_root) -> void {
+  auto item = cJSON_GetObjectItem(sub_root, "seed");
+  if (item != nullptr) {
+    set_random_seed(static_cast<uint64_t>(item->valuedouble));
+  }
+}
+auto scene::parse_tile_size(cJSON *sub_root) -> void {
+  auto item = cJSON_GetObjectItem(sub_root, "tile_size");
+  if (item != nullptr) {
+    tile_size = item->valueint;
+  }
+}
+auto scene::hash_scene(const cJSON *sub_root) -> void {
+  // 只影响渲染方式、不改变采样结果的键不参与哈希；pps 由断点单独校验
+  static const char *const render_only[] = {"pps", "image_name", "adaptive_threshold",
+      "min_pps", "max_pps", "progressive_pps", "snapshot_interval_s", "checkpoint",
+      "checkpoint_interval_s", "time_budget_s", "threads", "tile_size", "bvh_split",
+      "bvh_layout", "mesh_cache", "mesh_cache_dir", "packet_tracing", "wavefront"};
+  auto copy = cJSON_Duplicate(sub_root, true);
+  for (auto key : render_only)
+    cJSON_DeleteItemFromObject(copy, key);
+  auto text = cJSON_PrintUnformatted(copy);
+  scene_hash = mix_bits(scene_hash ^ std::hash<std::string_view>{}(text));
+  cJSON_free(text);
+  cJSON_Delete(copy);
+}
 auto scene::scene_parse_sub(const std::string &json_path) -> bool {
   // 打开 JSON 文件
   std::ifstream file(json_path);
@@ -872,8 +1107,11 @@ auto scene::scene_parse_sub(const std::string &json_path) -> bool {
   auto sub = cJSON_Parse(jsonString.c_str());
   if (sub == nullptr) {
     std::cerr << " json file can not parse!\n";
+    return false;
   }
+  hash_scene(sub);
   parse_inherit(sub);
+  parse_seed(sub);
   parse_scene_id(sub);
   parse_image_name(sub);
   parse_vup(sub);
@@ -882,7 +1120,19 @@ auto scene::scene_parse_sub(const std::string &json_path) -> bool {
   parse_background(sub);
   parse_max_depth(sub);
   parse_pps(sub);
+  parse_adaptive(sub);
+  parse_progressive(sub);
+  parse_checkpoint(sub);
+  parse_time_budget(sub);
   parse_threads(sub);
+  parse_tile_size(sub);
+  parse_bvh_split(sub);
+  parse_bvh_layout(sub);
+  parse_mesh_cache(sub);
+  parse_packet_tracing(sub);
+  parse_wavefront(sub);
+  parse_integrator(sub);
+  parse_sampler(sub);
 
   if (scene_id == -1) {
     parse_image_size(sub);
@@ -915,9 +1165,12 @@ auto scene::scene_parse(const std::string &json_path) -> bool {
   root = cJSON_Parse(jsonString.c_str());
   if (root == nullptr) {
     std::cerr << " json file can not parse!\n";
+    return false;
   }
   json_set.insert(json_path);
+  hash_scene(root);
   parse_inherit(root);
+  parse_seed(root);
   parse_scene_id(root);
   parse_image_name(root);
   parse_vup(root);
@@ -926,7 +1179,23 @@ auto scene::scene_parse(const std::string &json_path) -> bool {
   parse_background(root);
   parse_max_depth(root);
   parse_pps(root);
+  parse_adaptive(root);
+  parse_progressive(root);
+  parse_checkpoint(root);
+  parse_time_budget(root);
   parse_threads(root);
+  parse_tile_size(root);
+  parse_bvh_split(root);
+  parse_bvh_layout(root);
+  parse_mesh_cache(root);
+  parse_packet_tracing(root);
+  parse_wavefront(root);
+  parse_integrator(root);
+  parse_sampler(root);
+  if (!check_settings()) {
+    cJSON_Delete(root);
+    return false;
+  }
 
   if (scene_id == -1) {
     parse_image_size(root);
@@ -937,6 +1206,7 @@ auto scene::scene_parse(const std::string &json_path) -> bool {
     choose_scene(scene_id, *world, *light, aspect_ratio, image_width, vfov, lookfrom, lookat, vup,
         background);
   }
+  build_world_bvh();
 #ifdef LOG
   std::cout << "[img name]: " << image_name << "\n";
 #endif
@@ -953,6 +1223,17 @@ auto scene::scene_parse(const std::string &json_path) -> bool {
   renderer->set_max_depth(max_depth);
   renderer->set_background(background);
   renderer->set_async_num(threads);
+  renderer->set_tile_size(tile_size);
+  renderer->set_packet_tracing(packet_tracing);
+  renderer->set_wavefront(wavefront);
+  renderer->set_rr_depth(rr_depth);
+  renderer->set_adaptive(adaptive_threshold, min_pps, max_pps);
+  renderer->set_progressive(progressive_pps, snapshot_interval);
+  renderer->set_checkpoint(checkpoint_interval, checkpoint_path);
+  renderer->set_scene_hash(scene_hash);
+  renderer->set_time_budget(time_budget);
+  renderer->set_integrator(integrator);
+  set_sampler(sampler_kind);
 
   // 释放内存
   cJSON_Delete(root);
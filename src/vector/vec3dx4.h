@@ -7,6 +7,7 @@
 #define VECTOR3DX4_HPP
 
 #include "../global.hpp"
+#include "../sampler/sampler.hpp"
 #include <ostream>
 
 #include "immintrin.h"
@@ -181,33 +182,23 @@ inline auto random_in_hemisphere(const vec3d &normal) -> vec3d {
     return -in_unit_sphere;
 }
 
-// 平面单位圆内随机一点（z = 0）；
+// 平面单位圆内随机一点（z = 0）；同心圆映射，正方形上分层的样本映到圆上仍然分层
 auto random_in_unit_disk() -> vec3d {
-  // double angle = random_double() * 2 * PI;  // 生成随机的角度
-  // double radius = random_double();  // 生成随机的半径
-
-  // #ifdef DEBUG
-  //   auto p = vec3d(radius * cos(angle), radius * sin(angle), 0.0);
-  //   if (p.length_squared() >= 1) {
-  //     std::cerr << " not in a circle \n";
-  //   }
-  // #endif
-
-  // return {radius * cos(angle), radius * sin(angle), 0.0};
-
-  auto fun = random_double(-1, 1);
-  while (true) {
-    auto p = vec3d(fun(), fun(), 0);
-    if (p.length_squared() >= 1)
-      continue;
-    return p;
-  }
+  auto [a, b] = sample_2d();
+  a = 2 * a - 1, b = 2 * b - 1;
+  if (a == 0 && b == 0)
+    return {0, 0, 0};
+  double radius, angle;
+  if (std::abs(a) > std::abs(b))
+    radius = a, angle = PI / 4 * (b / a);
+  else
+    radius = b, angle = PI / 2 - PI / 4 * (a / b);
+  return {radius * cos(angle), radius * sin(angle), 0.0};
 }
 
 // 随机 cos 方向
 inline auto random_cosine_direction() -> vec3d {
-  auto r1 = random_double();
-  auto r2 = random_double();
+  auto [r1, r2] = sample_2d();
 
   auto phi = 2 * PI * r1;
   auto x = cos(phi) * sqrt(r2);
@@ -218,8 +209,7 @@ inline auto random_cosine_direction() -> vec3d {
 }
 
 inline auto random_to_sphere(double radius, double distance_squared) -> vec3d {
-  auto r1 = random_double();
-  auto r2 = random_double();
+  auto [r1, r2] = sample_2d();
   auto z = 1 + r2 * (sqrt(1 - radius * radius / distance_squared) - 1);
 
   auto phi = 2 * PI * r1;
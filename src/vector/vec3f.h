@@ -0,0 +1,64 @@
+/**
+ * @file vec3f.h
+ * @brief vec3 float 类，单精度的点/向量 {x, y, z, w}，用 __m128 存储，大小为 vec3d 的一半
+ *
+ */
+#ifndef VECTOR3F_HPP
+#define VECTOR3F_HPP
+
+#include "vec3dx4.h"
+
+/**
+ * @class vec3f
+ * @brief 单精度向量，用于按 float 存放的网格顶点和单精度求交
+ *
+ * 只提供求交需要的运算；与 vec3d 之间的转换都是显式的
+ */
+class vec3f {
+public:
+  using f32x4 = __m128;
+  f32x4 e;
+
+public:
+  vec3f() : e() {}
+  vec3f(const f32x4 &f4) : e(f4) {}
+  vec3f(float xx, float yy, float zz) : e{xx, yy, zz, 0.0f} {}
+  // double 转 float（就近舍入）
+  explicit vec3f(const vec3d &v) : e(_mm256_cvtpd_ps(v.e)) {}
+  // clang-format off
+  auto operator[](int i) const -> float { return e[i]; }
+  [[nodiscard]] inline auto x() const -> float { return e[0]; }
+  [[nodiscard]] inline auto y() const -> float { return e[1]; }
+  [[nodiscard]] inline auto z() const -> float { return e[2]; }
+  // float 转 double 是精确的
+  [[nodiscard]] inline auto to_vec3d() const -> vec3d { return _mm256_cvtps_pd(e); }
+  auto operator-() const -> vec3f { return -e; }
+  auto operator+(const vec3f &v) const -> vec3f { return e + v.e; }
+  auto operator-(const vec3f &v) const -> vec3f { return e - v.e; }
+  auto operator*(const vec3f &v) const -> vec3f { return e * v.e; }
+  auto operator*(float r) const -> vec3f { return e * r; }
+  // |x| + |y| + |z|，不小于模长，用于估计舍入误差的上界
+  [[nodiscard]] auto abs_sum3() const -> float {
+    auto a = _mm_andnot_ps(_mm_set1_ps(-0.0f), e);
+    return a[0] + a[1] + a[2];
+  }
+  // clang-format on
+  friend auto operator<<(std::ostream &os, const vec3f &v) -> std::ostream & {
+    return os << v.to_vec3d();
+  }
+};
+
+// 点乘
+inline auto dot(const vec3f &a, const vec3f &b) -> float {
+  auto m = a.e * b.e;
+  return m[0] + m[1] + m[2];
+}
+// 叉乘：(a.yzx * b.zxy - a.zxy * b.yzx)
+inline auto cross(const vec3f &a, const vec3f &b) -> vec3f {
+  auto a_yzx = _mm_shuffle_ps(a.e, a.e, _MM_SHUFFLE(3, 0, 2, 1));
+  auto b_yzx = _mm_shuffle_ps(b.e, b.e, _MM_SHUFFLE(3, 0, 2, 1));
+  auto c = a.e * b_yzx - a_yzx * b.e;
+  return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+#endif